@@ -9,6 +9,7 @@
 
 #include "gameobject.hpp"
 #include "geometryhandler.hpp"
+#include "renderable.hpp"
 
 struct ObjectData
 {
@@ -18,7 +19,7 @@ public:
 	float mOrientation;
 };
 
-class BackgroundObject : public GameObject, private GeometryHandler
+class BackgroundObject : public GameObject, public Renderable, private GeometryHandler
 {
 public:
 	//No default ctor
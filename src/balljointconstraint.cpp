@@ -2,7 +2,6 @@
 
 #include<glm/gtc/quaternion.hpp>
 #include<glm/gtx/quaternion.hpp>
-#include<sgct/log.h>
 #include<glm/gtx/string_cast.hpp>
 #include<iostream>
 #include<cassert>
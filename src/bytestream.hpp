@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+//Bytes owned by someone else, what std::span<const std::byte> is in C++20
+struct ByteSpan
+{
+	ByteSpan() = default;
+	ByteSpan(const std::byte* data, size_t size) : mData{ data }, mSize{ size } {}
+	ByteSpan(const std::vector<std::byte>& bytes) : mData{ bytes.data() }, mSize{ bytes.size() } {}
+
+	const std::byte* mData = nullptr;
+	size_t mSize = 0;
+};
+
+//Writes plain values in host byte order into memory the caller has already sized
+//Used to serialize in place into a buffer that is reused between frames
+class ByteWriter
+{
+public:
+	ByteWriter(std::byte* begin, std::byte* end) : mCursor{ begin }, mEnd{ end } {}
+
+	template<typename T>
+	void write(T value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be written");
+		writeBytes(&value, sizeof(T));
+	}
+
+	void writeBytes(const void* bytes, size_t size)
+	{
+		assert(mCursor + size <= mEnd && "ByteWriter buffer too small");
+		std::memcpy(mCursor, bytes, size);
+		mCursor += size;
+	}
+
+	//Reserve room for a value only known later, fill it with writeAt
+	template<typename T>
+	std::byte* skip()
+	{
+		std::byte* at = mCursor;
+		write(T{});
+		return at;
+	}
+
+	template<typename T>
+	static void writeAt(std::byte* at, T value)
+	{
+		std::memcpy(at, &value, sizeof(T));
+	}
+
+	std::byte* getCursor() const { return mCursor; }
+
+private:
+	std::byte* mCursor;
+	std::byte* mEnd;
+};
+
+//Reads plain values from a span, every read fails instead of running past the end
+class ByteReader
+{
+public:
+	ByteReader(ByteSpan data, size_t pos) : mData{ data }, mPos{ pos } {}
+
+	//Returns false and leaves value untouched if the data ends before the value
+	template<typename T>
+	bool read(T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be read");
+		return readBytes(&value, sizeof(T));
+	}
+
+	bool readBytes(void* bytes, size_t size)
+	{
+		if (size > getRemaining())
+			return false;
+		std::memcpy(bytes, mData.mData + mPos, size);
+		mPos += size;
+		return true;
+	}
+
+	void setPos(size_t pos) { mPos = pos; }
+	size_t getPos() const { return mPos; }
+	size_t getRemaining() const { return mPos < mData.mSize ? mData.mSize - mPos : 0; }
+
+private:
+	ByteSpan mData;
+	size_t mPos;
+};
@@ -1,104 +1,205 @@
 #include "collectiblepool.hpp"
 
-void CollectiblePool::init()
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include <glm/gtc/constants.hpp>
+
+#include "simlog.hpp"
+
+namespace
+{
+	//Same model rotation as the GameObject default
+	const glm::quat baseModelRotation{ glm::vec3(glm::half_pi<float>(), 0.f, glm::pi<float>()) };
+
+}
+
+unsigned CollectiblePool::hashSeed(unsigned x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+float CollectiblePool::unitFloat(unsigned hash)
+{
+	return (hash >> 8) * (1.f / 16777216.f);
+}
+
+void CollectiblePool::init(float queryAngle, size_t capacity)
 {
 	ZoneScoped;
-	//Copy trash models from allModelNames
-	std::vector<std::string> trashModelNames;
-	for (const std::string& name : allModelNames)
+	//Find trash models in allModelNames, ModelManager loads them in the same order
+	mTrashModels.clear();
+	for (size_t i = 0; i < allModelNames.size(); i++)
 	{
+		const std::string& name = allModelNames[i];
 		if (name == "fish" || name == "diver" || name == "background")
 			continue;
 
-		trashModelNames.push_back(name);
+		mTrashModels.push_back(static_cast<int>(i));
 	}
 
-	//Add objects to pool, set up list
-	for (size_t i = 0; i < mMAXNUMCOLLECTIBLES; i++)
-	{
-		Collectible tempCollectible{ Collectible(trashModelNames[i % trashModelNames.size()])
-		};
-		mPool.push_back(std::move(tempCollectible));
-	}
+	mPositions.clear();
+	mSpawnTimes.clear();
+	mSeeds.clear();
+	mModelIndices.clear();
+	mEvents.clear();
+	mNumEnabled = 0;
+	mCapacity = capacity;
 
-	//Set up pointer list
-	mFirstAvailable = &mPool[0];
-	for (size_t i = 0; i < mMAXNUMCOLLECTIBLES - 1; i++)
-	{
-		mPool[i].setNext(&mPool[i + 1]);
-	}
-	mPool[mPool.size() - 1].setNext(nullptr);
+	mGrid.init(mGRIDRESOLUTION, queryAngle, 0);
+	growTo(std::min(mCHUNKSIZE, mCapacity));
 
-	std::string sizeInfoString = std::to_string(mPool.size());
-	sgct::Log::Info("Collectible pool with %s elements created", sizeInfoString.c_str());
+	SimLog::info("Collectible pool with capacity " + std::to_string(mCapacity) + " created");
 }
 
-void CollectiblePool::render(const glm::mat4& mvp, const glm::mat4& v) const
+void CollectiblePool::enableCollectible(const glm::quat& pos, float spawnTime)
 {
 	ZoneScoped;
-	if (mPool.size() > 0)
-	{
-		auto const& collectibleShader = mPool[0].mShaderProgram;
-		collectibleShader.bind();
-		for (size_t i = 0; i < mNumEnabled; i++)
-		{
-			mPool[i].render(mvp, v);
-		}
-		collectibleShader.unbind();
-	}
+	if (mNumEnabled == mCapacity)
+		return;
+
+	if (mNumEnabled == mPositions.size())
+		growTo(mNumEnabled + 1);
+
+	const size_t slot = mNumEnabled++;
+	mPositions[slot] = pos;
+	mSpawnTimes[slot] = spawnTime;
+	mSeeds[slot] = mNextSeed++;
+	mModelIndices[slot] = mTrashModels[mNextTrashModel];
+	mNextTrashModel = (mNextTrashModel + 1) % mTrashModels.size();
+
+	mGrid.insert(slot, getDirection(slot));
+
+	if (mLogEvents)
+		mEvents.push_back(Event{ Event::SPAWN, static_cast<unsigned>(slot), getCollectibleData(slot) });
 }
 
-std::vector<CollectibleData> CollectiblePool::getPoolState()
+size_t CollectiblePool::enableCollectibles(const std::vector<glm::quat>& positions, float spawnTime)
 {
 	ZoneScoped;
-	std::vector<CollectibleData> poolData;
-	poolData.reserve(mNumEnabled);
+	const size_t numNew = std::min(positions.size(), mCapacity - mNumEnabled);
+	if (mNumEnabled + numNew > mPositions.size())
+		growTo(mNumEnabled + numNew);
 
-	for (size_t i = 0; i < mPool.size(); i++)
-	{
-		if (mPool[i].isEnabled())
-		{
-			poolData.push_back(mPool[i].getCollectibleData(i));
-		}
-	}
+	for (size_t i = 0; i < numNew; i++)
+		enableCollectible(positions[i], spawnTime);
 
-	return poolData;
+	return numNew;
 }
 
-void CollectiblePool::enableCollectible(const glm::vec3& pos)
+bool CollectiblePool::disableCollectibleWithSeed(unsigned seed)
 {
 	ZoneScoped;
-	if (mFirstAvailable == nullptr)
-		return;
-
-	Collectible& newCollectible = *mFirstAvailable;
-	mFirstAvailable = newCollectible.getNext();
+	const auto enabledEnd = mSeeds.begin() + mNumEnabled;
+	const auto found = std::find(mSeeds.begin(), enabledEnd, seed);
+	if (found == enabledEnd)
+		return false;
 
-	newCollectible.setPosition(pos);
-	newCollectible.enable();
-
-	++mNumEnabled;
+	disableCollectibleAndSwap(static_cast<size_t>(found - mSeeds.begin()));
+	return true;
 }
 
 void CollectiblePool::disableCollectibleAndSwap(const size_t index)
 {
 	ZoneScoped;
-	std::swap(mPool[index], mPool[mNumEnabled - 1]);
-
-	auto& lastEnabledElement = mPool[index];
-	auto& disabledElement = mPool[mNumEnabled - 1];
+	assert(index < mNumEnabled && "Disabling collectible that is not enabled");
+	const size_t last = mNumEnabled - 1;
 
-	//Thread enabled object
-	lastEnabledElement.setNext(&mPool[index+1]);
-	if (index > 0)
-		mPool[index - 1].setNext(&lastEnabledElement);
+	//Keep the grid in step with the move below
+	mGrid.remove(index);
+	mGrid.move(last, index);
 
-	//Rethread and prime disabled object for usage
-	disabledElement.disable();
-	disabledElement.setNext(mFirstAvailable);
-	if (mNumEnabled > 1)
-		mPool[mNumEnabled - 2].setNext(&disabledElement);	
-	mFirstAvailable = &disabledElement;
+	mPositions[index] = mPositions[last];
+	mSpawnTimes[index] = mSpawnTimes[last];
+	mSeeds[index] = mSeeds[last];
+	mModelIndices[index] = mModelIndices[last];
 
 	--mNumEnabled;
-}
\ No newline at end of file
+
+	if (mLogEvents)
+		mEvents.push_back(Event{ Event::COLLECT, static_cast<unsigned>(index), CollectibleData{} });
+}
+
+PositionData CollectiblePool::getPositionData(const size_t index) const
+{
+	PositionData temp;
+	temp.mRadius = DOMERADIUS;
+	temp.mOrientation = 0.f;
+	temp.mScale = COLLECTIBLESCALE;
+
+	const glm::quat& position = mPositions[index];
+	temp.mW = position.w;
+	temp.mX = position.x;
+	temp.mY = position.y;
+	temp.mZ = position.z;
+
+	return temp;
+}
+
+CollectibleData CollectiblePool::getCollectibleData(const size_t index) const
+{
+	CollectibleData temp;
+	temp.mModelIndex = mModelIndices[index];
+	temp.mSpawnTime = mSpawnTimes[index];
+	temp.mSeed = mSeeds[index];
+
+	return temp;
+}
+
+void CollectiblePool::setCollectibleData(const size_t index, const PositionData& newPosData,
+                                         const CollectibleData& newCollectData)
+{
+	glm::quat newPosition;
+	newPosition.w = newPosData.mW;
+	newPosition.x = newPosData.mX;
+	newPosition.y = newPosData.mY;
+	newPosition.z = newPosData.mZ;
+
+	mPositions[index] = newPosition;
+	mSpawnTimes[index] = newCollectData.mSpawnTime;
+	mSeeds[index] = newCollectData.mSeed;
+	mModelIndices[index] = newCollectData.mModelIndex;
+}
+
+void CollectiblePool::setNumEnabled(size_t size)
+{
+	//Master decides how many are enabled, follow it even if this node is configured smaller
+	if (size > mPositions.size())
+		growTo(size);
+
+	mNumEnabled = size;
+}
+
+void CollectiblePool::growTo(size_t numSlots)
+{
+	ZoneScoped;
+	const size_t numChunks = (numSlots + mCHUNKSIZE - 1) / mCHUNKSIZE;
+	const size_t newSize = std::max(mPositions.size(), numChunks * mCHUNKSIZE);
+
+	mPositions.resize(newSize, glm::quat{});
+	mSpawnTimes.resize(newSize, 0.f);
+	mSeeds.resize(newSize, 0u);
+	mModelIndices.resize(newSize, mTrashModels.front());
+	mGrid.resizeSlots(newSize);
+}
+
+glm::quat CollectiblePool::getModelRotation(const size_t index, float time) const
+{
+	//Random axis uniformly distributed on the unit sphere and random start angle
+	const unsigned hash = hashSeed(mSeeds[index]);
+	const float axisZ = 2.f * unitFloat(hash) - 1.f;
+	const float axisAngle = glm::two_pi<float>() * unitFloat(hashSeed(hash));
+	const float startAngle = glm::two_pi<float>() * unitFloat(hashSeed(hash + 1));
+
+	const float ringRadius = std::sqrt(std::max(0.f, 1.f - axisZ * axisZ));
+	const glm::vec3 spinAxis{ ringRadius * std::cos(axisAngle), ringRadius * std::sin(axisAngle), axisZ };
+
+	const float angle = startAngle + mSPINSPEED * (time - mSpawnTimes[index]);
+	return baseModelRotation * glm::angleAxis(std::fmod(angle, glm::two_pi<float>()), spinAxis);
+}
@@ -1,66 +1,143 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
-#include "sgct/log.h"
-#include "sgct/shadermanager.h"
-#include "sgct/profiling.h"
+#include <glm/gtc/quaternion.hpp>
 
-#include "collectible.hpp"
+#include "profiling.hpp"
+#include "gameobject.hpp"
 #include "constants.hpp"
+#include "spheregrid.hpp"
+
+//POD struct to sync collectible specific state
+//Spin is not synced, every node evaluates it from mSpawnTime and mSeed
+struct CollectibleData
+{
+	int mModelIndex;
+	float mSpawnTime;
+	unsigned mSeed;
+};
 
 //Contain all collectibles with object pool design pattern
 //Game contains an instance of this class
-//Pool is stable partitioned with enabled objects in front ACTUALLY this does not seem to be the case?
+//State is stored as structure of arrays, indexed by slot. Enabled collectibles are
+//always kept densely packed in slots [0, getNumEnabled()) so every loop over them
+//is a tight loop over contiguous memory. Slots are allocated mCHUNKSIZE at a time
+//up to the capacity given to init. Objects are only ever referred to by slot, never
+//by address, so growing the arrays invalidates nothing
 class CollectiblePool
 {
 public:
-	//Ctor creates pool of mNumCollectibles collectibles
-	//Alternates between all trash models
-	//Points mFirstAvailable to first element	
 	CollectiblePool() = default;
 
-	//creates pool of mNumCollectibles collectibles
-	//Alternates between all trash models
-	//Points mFirstAvailable to first element	
-	void init();
-
-	//Render enabled objects
-	void render(const glm::mat4& mvp, const glm::mat4& v) const;
-	
-	//Get collectiblepool state
-	std::vector<CollectibleData> getPoolState();
-
-	//Returns shared_ptr and points mFirstAvailable to next in list. O(1)!
-	void enableCollectible(const glm::vec3& pos);
-
-	//Deactivates object at index and swaps to front (Used on master)
+	//A spawn or collect, in the order they change the slots
+	struct Event
+	{
+		enum Type : uint8_t
+		{
+			SPAWN,
+			COLLECT
+		};
+
+		Type mType;
+		unsigned mSlot;
+
+		//Collectible that was spawned, unused for collects
+		CollectibleData mData;
+	};
+
+	//Allocates the first chunk of slots and the broad-phase grid
+	//queryAngle is the widest cone that will be used to query the grid,
+	//capacity is the most collectibles that can be enabled at once
+	void init(float queryAngle, size_t capacity);
+
+	//Enables a collectible at pos in the first free slot. O(1)! (amortized)
+	//spawnTime is the simulation time, spin starts from it
+	//Does nothing if capacity collectibles are already enabled
+	void enableCollectible(const glm::quat& pos, float spawnTime);
+
+	//Enables a collectible at each of positions, allocating once. O(k)
+	//Returns how many fit, their seeds are getNextSeed() before the call and onwards
+	size_t enableCollectibles(const std::vector<glm::quat>& positions, float spawnTime);
+
+	//Deactivates the collectible spawned with seed if it is still enabled. O(n)
+	//Returns false if it has already been disabled
+	bool disableCollectibleWithSeed(unsigned seed);
+
+	//Deactivates object at index and moves the last enabled object into its slot (Used on master)
 	void disableCollectibleAndSwap(const size_t index);
 
-	//Simply deactivates element at index
-	void disableCollectible(const size_t index) { mPool[index].disable(); }
+	//Record every spawn and collect, SyncEncoder sends them instead of the collectibles
+	//The log grows until clearEvents() is called
+	void setEventLogging(bool enabled) { mLogEvents = enabled; }
+	const std::vector<Event>& getEvents() const { return mEvents; }
+	void clearEvents() { mEvents.clear(); }
 
-	//Operator overloading to hide internal data
-	Collectible& operator[](const size_t i) { return mPool[i]; }
+	//Sync methods
+	PositionData getPositionData(const size_t index) const;
+	CollectibleData getCollectibleData(const size_t index) const;
+	void setCollectibleData(const size_t index, const PositionData& newPosData,
+	                        const CollectibleData& newCollectData);
 
 	//Accessors/Mutator
 	size_t getNumEnabled() const { return mNumEnabled; }
-	void setNumEnabled(size_t size) { mNumEnabled = size; }
+	size_t getCapacity() const { return mCapacity; }
+	unsigned getNextSeed() const { return mNextSeed; }
+	void setNumEnabled(size_t size);
+	const glm::quat& getPosition(const size_t index) const { return mPositions[index]; }
+	glm::vec3 getDirection(const size_t index) const { return mPositions[index] * glm::vec3(0.f, 0.f, -1.f); }
+	//Spin of the object in slot index at simulation time time
+	glm::quat getModelRotation(const size_t index, float time) const;
+	int getModelIndex(const size_t index) const { return mModelIndices[index]; }
+	const SphereGrid& getGrid() const { return mGrid; }
+
+	//Number of slots allocated when the pool runs out
+	static constexpr size_t mCHUNKSIZE = 256;
+
+	//Broad-phase grid cells per cube face edge
+	static constexpr unsigned mGRIDRESOLUTION = 8;
+
+	//Spin speed in radians per second
+	static constexpr float mSPINSPEED = 2.08f;
 
-	//Max number of collectibles
-	static constexpr unsigned mMAXNUMCOLLECTIBLES = 300;
+	//Integer hash with good avalanche, spreads consecutive seeds over all bits
+	static unsigned hashSeed(unsigned x);
+
+	//Uniform float in [0, 1) from the top 24 bits of a hash
+	static float unitFloat(unsigned hash);
 
 private:
-	//The pool of collectible objects
-	std::vector<Collectible> mPool;
+	//Allocate chunks until there are at least numSlots slots
+	void growTo(size_t numSlots);
+
+	//Position on the sphere of each slot
+	std::vector<glm::quat> mPositions;
+
+	//Simulation time each slot was enabled at
+	std::vector<float> mSpawnTimes;
+
+	//Picks spin axis and start angle of each slot
+	std::vector<unsigned> mSeeds;
+	unsigned mNextSeed = 0;
 
-	//Number of enabled objects
+	//Slot in ModelManager of the model each slot is rendered with
+	std::vector<int> mModelIndices;
+
+	//Number of enabled objects, these occupy the first mNumEnabled slots
 	size_t mNumEnabled = 0;
 
-	//Pointer to first available object ready to import into the game
-	Collectible* mFirstAvailable = nullptr;
+	//Max number of enabled objects on master
+	size_t mCapacity = 0;
+
+	//ModelManager slots of all trash models, newly enabled objects cycle through these
+	std::vector<int> mTrashModels;
+	size_t mNextTrashModel = 0;
+
+	//Enabled objects binned by direction, indexed by pool slot
+	SphereGrid mGrid;
 
-	//Limit on number of objects in pool
-	
-	
-};
\ No newline at end of file
+	//See setEventLogging
+	std::vector<Event> mEvents;
+	bool mLogEvents = false;
+};
@@ -0,0 +1,37 @@
+#include "collectiblerenderer.hpp"
+
+CollectibleRenderer::CollectibleRenderer()
+	: GeometryHandler{ "collectible", "can1" }
+{
+	setShaderData();
+}
+
+void CollectibleRenderer::render(const CollectiblePool& pool, const glm::mat4& mvp,
+                                 const glm::mat4& v, float time) const
+{
+	ZoneScoped;
+	if (pool.getNumEnabled() == 0)
+		return;
+
+	mShaderProgram.bind();
+
+	//Uniforms shared by all collectibles
+	glm::vec3 cameraPos = glm::vec3((inverse(v))[3]);
+	glUniform3fv(mCameraPosLoc, 1, glm::value_ptr(cameraPos));
+	glUniformMatrix4fv(mMvpMatrixLoc, 1, GL_FALSE, glm::value_ptr(mvp));
+	glUniformMatrix4fv(mViewMatrixLoc, 1, GL_FALSE, glm::value_ptr(v));
+
+	for (size_t i = 0; i < pool.getNumEnabled(); i++)
+	{
+		glm::mat4 transformation = GameObject::composeTransformation(pool.getPosition(i), DOMERADIUS,
+			0.f, COLLECTIBLESCALE, pool.getModelRotation(i, time));
+		glm::mat3 normalMatrix(glm::transpose(glm::inverse(transformation)));
+
+		glUniformMatrix3fv(mNormalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+		glUniformMatrix4fv(mTransMatrixLoc, 1, GL_FALSE, glm::value_ptr(transformation));
+
+		ModelManager::instance().getModel(pool.getModelIndex(i)).render();
+	}
+
+	mShaderProgram.unbind();
+}
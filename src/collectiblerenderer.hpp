@@ -0,0 +1,18 @@
+#pragma once
+
+#include "sgct/profiling.h"
+
+#include "geometryhandler.hpp"
+#include "collectiblepool.hpp"
+
+//Draws the enabled collectibles of a CollectiblePool
+//The pool only stores simulation state, shader and uniform locations are shared here
+class CollectibleRenderer : private GeometryHandler
+{
+public:
+	CollectibleRenderer();
+
+	//Render enabled objects spun to simulation time time
+	void render(const CollectiblePool& pool, const glm::mat4& mvp, const glm::mat4& v,
+	            float time) const;
+};
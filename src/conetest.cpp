@@ -0,0 +1,164 @@
+#include "conetest.hpp"
+
+#include <cassert>
+
+#if defined(__AVX2__)
+	#define CONETEST_AVX2
+	#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CONETEST_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace
+{
+	//Append the lanes set in mask, offset by base, to hits
+	inline size_t appendMask(unsigned mask, unsigned lanes, size_t base, unsigned* hits, size_t numHits)
+	{
+		for (unsigned lane = 0; lane < lanes && mask != 0; ++lane, mask >>= 1)
+		{
+			if (mask & 1u)
+				hits[numHits++] = static_cast<unsigned>(base + lane);
+		}
+		return numHits;
+	}
+
+	//Scalar fallback and remainder of the vector paths, tests i from begin on
+	inline size_t scalarHits(const float* xs, const float* ys, const float* zs, size_t begin, size_t count,
+	                         const glm::vec3& direction, float cosAngle, unsigned* hits, size_t numHits)
+	{
+		for (size_t i = begin; i < count; ++i)
+		{
+			const float dot = xs[i] * direction.x + ys[i] * direction.y + zs[i] * direction.z;
+			if (dot >= cosAngle)
+				hits[numHits++] = static_cast<unsigned>(i);
+		}
+		return numHits;
+	}
+
+#if defined(CONETEST_AVX2)
+	size_t avx2Hits(const float* xs, const float* ys, const float* zs, size_t count,
+	                const glm::vec3& direction, float cosAngle, unsigned* hits)
+	{
+		size_t numHits = 0;
+		size_t i = 0;
+
+		const __m256 dx = _mm256_set1_ps(direction.x);
+		const __m256 dy = _mm256_set1_ps(direction.y);
+		const __m256 dz = _mm256_set1_ps(direction.z);
+		const __m256 threshold = _mm256_set1_ps(cosAngle);
+
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 dot = _mm256_mul_ps(_mm256_loadu_ps(xs + i), dx);
+			dot = _mm256_add_ps(dot, _mm256_mul_ps(_mm256_loadu_ps(ys + i), dy));
+			dot = _mm256_add_ps(dot, _mm256_mul_ps(_mm256_loadu_ps(zs + i), dz));
+
+			const unsigned mask = static_cast<unsigned>(
+				_mm256_movemask_ps(_mm256_cmp_ps(dot, threshold, _CMP_GE_OQ)));
+			if (mask != 0)
+				numHits = appendMask(mask, 8, i, hits, numHits);
+		}
+		return scalarHits(xs, ys, zs, i, count, direction, cosAngle, hits, numHits);
+	}
+#endif
+
+#if defined(CONETEST_SSE2)
+	size_t sse2Hits(const float* xs, const float* ys, const float* zs, size_t count,
+	                const glm::vec3& direction, float cosAngle, unsigned* hits)
+	{
+		size_t numHits = 0;
+		size_t i = 0;
+
+		const __m128 dx = _mm_set1_ps(direction.x);
+		const __m128 dy = _mm_set1_ps(direction.y);
+		const __m128 dz = _mm_set1_ps(direction.z);
+		const __m128 threshold = _mm_set1_ps(cosAngle);
+
+		//Two registers per iteration to test 8 directions at a time
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128 dotLo = _mm_mul_ps(_mm_loadu_ps(xs + i), dx);
+			__m128 dotHi = _mm_mul_ps(_mm_loadu_ps(xs + i + 4), dx);
+			dotLo = _mm_add_ps(dotLo, _mm_mul_ps(_mm_loadu_ps(ys + i), dy));
+			dotHi = _mm_add_ps(dotHi, _mm_mul_ps(_mm_loadu_ps(ys + i + 4), dy));
+			dotLo = _mm_add_ps(dotLo, _mm_mul_ps(_mm_loadu_ps(zs + i), dz));
+			dotHi = _mm_add_ps(dotHi, _mm_mul_ps(_mm_loadu_ps(zs + i + 4), dz));
+
+			const unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_cmpge_ps(dotLo, threshold)))
+				| (static_cast<unsigned>(_mm_movemask_ps(_mm_cmpge_ps(dotHi, threshold))) << 4);
+			if (mask != 0)
+				numHits = appendMask(mask, 8, i, hits, numHits);
+		}
+		return scalarHits(xs, ys, zs, i, count, direction, cosAngle, hits, numHits);
+	}
+#endif
+}
+
+size_t ConeTest::findHits(const float* xs, const float* ys, const float* zs, size_t count,
+                          const glm::vec3& direction, float cosAngle, unsigned* hits)
+{
+#if defined(CONETEST_AVX2)
+	return avx2Hits(xs, ys, zs, count, direction, cosAngle, hits);
+#elif defined(CONETEST_SSE2)
+	return sse2Hits(xs, ys, zs, count, direction, cosAngle, hits);
+#else
+	return scalarHits(xs, ys, zs, 0, count, direction, cosAngle, hits, 0);
+#endif
+}
+
+const char* ConeTest::instructionSet()
+{
+#if defined(CONETEST_AVX2)
+	return getPathName(AVX2);
+#elif defined(CONETEST_SSE2)
+	return getPathName(SSE2);
+#else
+	return getPathName(SCALAR);
+#endif
+}
+
+bool ConeTest::hasPath(Path path)
+{
+	switch (path)
+	{
+#if defined(CONETEST_AVX2)
+	case AVX2:
+		return true;
+#endif
+#if defined(CONETEST_SSE2)
+	case SSE2:
+		return true;
+#endif
+	case SCALAR:
+		return true;
+	default:
+		return false;
+	}
+}
+
+const char* ConeTest::getPathName(Path path)
+{
+	static const char* names[NUMPATHS] = { "scalar", "SSE2", "AVX2" };
+	return path < NUMPATHS ? names[path] : "unknown";
+}
+
+size_t ConeTest::findHits(Path path, const float* xs, const float* ys, const float* zs, size_t count,
+                          const glm::vec3& direction, float cosAngle, unsigned* hits)
+{
+	assert(hasPath(path) && "Cone test path is not compiled in");
+	switch (path)
+	{
+#if defined(CONETEST_AVX2)
+	case AVX2:
+		return avx2Hits(xs, ys, zs, count, direction, cosAngle, hits);
+#endif
+#if defined(CONETEST_SSE2)
+	case SSE2:
+		return sse2Hits(xs, ys, zs, count, direction, cosAngle, hits);
+#endif
+	default:
+		return scalarHits(xs, ys, zs, 0, count, direction, cosAngle, hits, 0);
+	}
+}
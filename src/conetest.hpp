@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+//Narrow phase collision kernel for objects on the dome sphere
+//Two objects collide when the angle between their unit directions is within a cone,
+//i.e. when dot(a, b) >= cos(coneAngle). Directions are stored as separate x, y and z
+//arrays so the test runs on 8 directions at a time with AVX2, 2 x 4 with SSE2,
+//and falls back to plain scalar code on other targets
+namespace ConeTest
+{
+	//Writes the index of every direction (xs[i], ys[i], zs[i]), i < count, inside the cone
+	//around direction to hits in increasing order and returns the number of hits
+	//hits must have room for count indices
+	size_t findHits(const float* xs, const float* ys, const float* zs, size_t count,
+	                const glm::vec3& direction, float cosAngle, unsigned* hits);
+
+	//Name of the instruction set findHits() was compiled for
+	const char* instructionSet();
+
+	//Code paths of the kernel, findHits() takes the widest one that is compiled in
+	//AVX2 needs DOMEDAGEN_USE_AVX2, SSE2 is compiled in on every x86 target
+	enum Path : uint8_t
+	{
+		SCALAR,
+		SSE2,
+		AVX2,
+		NUMPATHS
+	};
+
+	bool hasPath(Path path);
+	const char* getPathName(Path path);
+
+	//findHits() through path, which has to be compiled in. For benchmarks and tests
+	size_t findHits(Path path, const float* xs, const float* ys, const float* zs, size_t count,
+	                const glm::vec3& direction, float cosAngle, unsigned* hits);
+}
@@ -0,0 +1,12 @@
+#include "eventscheduler.hpp"
+
+void EventScheduler::schedule(float time, EventType type, unsigned payload)
+{
+	mQueue.push(Event{ time, type, payload, mNextSequence++ });
+}
+
+void EventScheduler::clear()
+{
+	mQueue = decltype(mQueue){};
+	mNextSequence = 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <cstddef>
+
+//Queue of timed game events, ordered by simulation time
+//Events due at the same time run in the order they were scheduled, so a
+//simulation driven by the scheduler stays deterministic
+class EventScheduler
+{
+public:
+	enum class EventType
+	{
+		SPAWN,
+		DESPAWN,
+		ROUNDEND
+	};
+
+	struct Event
+	{
+		//Simulation time (seconds) the event is due
+		float mTime;
+		EventType mType;
+
+		//Event specific data, e.g. the seed of the collectible to despawn
+		unsigned mPayload;
+
+		//Scheduling order, breaks ties between events due at the same time
+		unsigned long long mSequence;
+	};
+
+	EventScheduler() = default;
+
+	//Add event due at time. O(log n)
+	void schedule(float time, EventType type, unsigned payload = 0);
+
+	//Remove and call func(event) for every event due at or before time, in order.
+	//func may schedule new events, these also run if they are due
+	template<typename Func>
+	void runDue(float time, Func&& func)
+	{
+		while (!mQueue.empty() && mQueue.top().mTime <= time)
+		{
+			const Event event = mQueue.top();
+			mQueue.pop();
+			func(event);
+		}
+	}
+
+	//Remove all events
+	void clear();
+
+	//Accessors
+	bool isEmpty() const { return mQueue.empty(); }
+	size_t getNumEvents() const { return mQueue.size(); }
+
+private:
+	//Orders the queue so the earliest event is on top
+	struct IsLater
+	{
+		bool operator()(const Event& a, const Event& b) const
+		{
+			if (a.mTime != b.mTime)
+				return a.mTime > b.mTime;
+			return a.mSequence > b.mSequence;
+		}
+	};
+
+	std::priority_queue<Event, std::vector<Event>, IsLater> mQueue;
+	unsigned long long mNextSequence = 0;
+};
@@ -31,16 +31,22 @@ GameObject::GameObject(const unsigned objType,
 
 glm::mat4 GameObject::getTransformation() const
 {
-	glm::mat4 trans    = glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -mRadius));
-	glm::mat4 orient   = glm::rotate(glm::mat4(1.f), mOrientation, glm::vec3(0, 0, 1));
-	glm::mat4 rot      = glm::toMat4(mPosition);
-	glm::mat4 scale    = glm::scale(glm::mat4(1.f), glm::vec3(mScale));
-	glm::mat4 localRot = glm::toMat4(mModelRotation);
+	return composeTransformation(mPosition, mRadius, mOrientation, mScale, mModelRotation);
+}
+
+glm::mat4 GameObject::composeTransformation(const glm::quat& position, float radius, float orientation,
+                                            float scale, const glm::quat& modelRotation)
+{
+	glm::mat4 trans    = glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -radius));
+	glm::mat4 orient   = glm::rotate(glm::mat4(1.f), orientation, glm::vec3(0, 0, 1));
+	glm::mat4 rot      = glm::toMat4(position);
+	glm::mat4 scaleMat = glm::scale(glm::mat4(1.f), glm::vec3(scale));
+	glm::mat4 localRot = glm::toMat4(modelRotation);
 
 	//std::cout << glm::to_string(trans) << '\n';
 
 	//TODO Put model rotation in a variable to allow models with different orientation
-	return rot * trans * orient * scale * localRot;
+	return rot * trans * orient * scaleMat * localRot;
 }
 
 const PositionData GameObject::getPositionData() const
@@ -52,12 +58,6 @@ const PositionData GameObject::getPositionData() const
 	temp.mScale = getScale();
 	//temp.mSpeed = getSpeed();
 
-	//Model rotation stuff
-	temp.mModelW = getModelRotation().w;
-	temp.mModelX = getModelRotation().x;
-	temp.mModelY = getModelRotation().y;
-	temp.mModelZ = getModelRotation().z;
-
 	//Quat stuff
 	temp.mW = getPosition().w;
 	temp.mX = getPosition().x;
@@ -74,13 +74,7 @@ void GameObject::setPositionData(const PositionData& newPosition)
 	setRadius(newPosition.mRadius);
 	setScale(newPosition.mScale);
 
-	//Model rotation stuff
-	glm::quat newModelRotation;
-	newModelRotation.w = newPosition.mModelW;
-	newModelRotation.x = newPosition.mModelX;
-	newModelRotation.y = newPosition.mModelY;
-	newModelRotation.z = newPosition.mModelZ;
-	setModelRotation(newModelRotation);
+	//Model rotation is set at construction and never changes, so it is not synced
 
 	//Quat stuff
 	glm::quat newQuat;
@@ -7,11 +7,6 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include "sgct/shadermanager.h"
-#include "sgct/shaderprogram.h"
-#include "glad/glad.h"
-
-#include "renderable.hpp"
 
 struct PositionData
 {
@@ -21,12 +16,6 @@ public:
 	float mOrientation;
 	float mScale;
 
-	//Model rotation stuff
-	float mModelW;
-	float mModelX;
-	float mModelY;
-	float mModelZ;
-
 	//Quat stuff
 	float mW;
 	float mX;
@@ -36,7 +25,7 @@ public:
 
 //A GameObject is located att the surface of a sphere
 //and it has a side that is always facing origin.
-class GameObject : public Renderable
+class GameObject
 {
 public:
 	//Enumerator to keep track of object type
@@ -63,10 +52,7 @@ public:
 
 
 	//Dtor implemented by subclasses
-	virtual ~GameObject() override = default;
-
-	////Render object, implemented by subclass
-	//virtual void render(const glm::mat4& mvp, const glm::mat4& v) const = 0;
+	virtual ~GameObject() = default;
 
 	//Update object (position, collision?)
 	virtual void update(float deltaTime) = 0;
@@ -78,11 +64,16 @@ public:
 	//Calculates and returns the objects transformation matrix
 	glm::mat4 getTransformation() const; // is there any reason for this not returning const&?
 
+	//Transformation matrix of an object with the given state, used by getTransformation()
+	static glm::mat4 composeTransformation(const glm::quat& position, float radius, float orientation,
+	                                       float scale, const glm::quat& modelRotation);
+
 	//Accessors
 	const float getScale() const { return mScale; }
 	const float getRadius() const { return mRadius; }
 	unsigned getObjType() const { return mObjType; }
 	const glm::quat& getPosition() const { return mPosition; }
+	glm::vec3 getDirection() const { return mPosition * glm::vec3(0.f, 0.f, -1.f); }
 	const glm::quat& getModelRotation() const { return mModelRotation; }
 	const float getOrientation() const { return mOrientation; }
 	const PositionData getPositionData() const;	
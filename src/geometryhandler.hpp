@@ -1,5 +1,9 @@
 #pragma once
 
+#include "sgct/shadermanager.h"
+#include "sgct/shaderprogram.h"
+#include "glad/glad.h"
+
 #include "modelmanager.hpp"
 
 //This class is privately inherited to classes needing models and accompanied functionality
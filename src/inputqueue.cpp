@@ -0,0 +1,50 @@
+#include "inputqueue.hpp"
+
+#include <cstring>
+
+InputQueue::InputQueue(size_t capacity)
+{
+	size_t numEvents = 2;
+	while (numEvents < capacity)
+		numEvents <<= 1;
+	mMask = numEvents - 1;
+	mEvents = std::make_unique<InputEvent[]>(numEvents);
+}
+
+InputQueue::PushResult InputQueue::push(ByteSpan data, RelayProtocol::Format format, double arrivalTime)
+{
+	const size_t pos = mPushPos.load(std::memory_order_relaxed);
+	if (pos - mPopPos.load(std::memory_order_acquire) > mMask || data.mSize > InputEvent::MAXBYTES)
+	{
+		mNumDropped.fetch_add(1, std::memory_order_relaxed);
+		return DROPPED;
+	}
+
+	//Parse the copy, so the name of a joining player points into the event
+	InputEvent& event = mEvents[pos & mMask];
+	if (data.mSize > 0)
+		std::memcpy(event.mData.data(), data.mData, data.mSize);
+	event.mSize = data.mSize;
+	if (!RelayProtocol::parse(event.getBytes(), format, event.mMessage))
+	{
+		mNumUnparsed.fetch_add(1, std::memory_order_relaxed);
+		return UNPARSED;
+	}
+	event.mArrivalTime = arrivalTime;
+
+	mPushPos.store(pos + 1, std::memory_order_release);
+	return QUEUED;
+}
+
+const InputEvent* InputQueue::front() const
+{
+	const size_t pos = mPopPos.load(std::memory_order_relaxed);
+	if (pos == mPushPos.load(std::memory_order_acquire))
+		return nullptr;
+	return &mEvents[pos & mMask];
+}
+
+void InputQueue::pop()
+{
+	mPopPos.store(mPopPos.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
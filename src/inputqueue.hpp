@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "bytestream.hpp"
+#include "relayprotocol.hpp"
+
+//Message from the web server, parsed when it arrived
+struct InputEvent
+{
+	//Larger messages are dropped, the web server only sends short ones
+	static constexpr size_t MAXBYTES = 256;
+
+	//The name of a joining player points into mData
+	RelayProtocol::Message mMessage;
+
+	//Engine time when the message arrived
+	double mArrivalTime = 0.0;
+
+	//The message as it arrived, for recordings
+	ByteSpan getBytes() const { return ByteSpan(mData.data(), mSize); }
+
+	std::array<std::byte, MAXBYTES> mData;
+	size_t mSize = 0;
+};
+
+//Messages from the web server on their way from the thread that receives them to the
+//thread that applies them. Events are parsed when they are pushed, so the consumer only
+//applies them. One producer and one consumer thread, neither waits for a lock
+class InputQueue
+{
+public:
+	//capacity is rounded up to a power of two
+	explicit InputQueue(size_t capacity);
+
+	InputQueue(const InputQueue&) = delete;
+	InputQueue& operator=(const InputQueue&) = delete;
+
+	enum PushResult : uint8_t
+	{
+		QUEUED,
+		//Larger than InputEvent::MAXBYTES or the queue is full
+		DROPPED,
+		//Not a message from the web server, e.g. text the server logs to the game
+		UNPARSED
+	};
+
+	//Parse data into the next free event. Producer thread only
+	PushResult push(ByteSpan data, RelayProtocol::Format format, double arrivalTime);
+
+	//Oldest event, nullptr if there is none. Valid until pop(). Consumer thread only
+	const InputEvent* front() const;
+	void pop();
+
+	//Accessors
+	unsigned getNumDropped() const { return mNumDropped.load(std::memory_order_relaxed); }
+	unsigned getNumUnparsed() const { return mNumUnparsed.load(std::memory_order_relaxed); }
+	size_t getCapacity() const { return mMask + 1; }
+
+private:
+	std::unique_ptr<InputEvent[]> mEvents;
+	size_t mMask;
+
+	//Next position to push and pop, on their own cache lines
+	alignas(64) std::atomic<size_t> mPushPos{ 0 };
+	alignas(64) std::atomic<size_t> mPopPos{ 0 };
+
+	//Messages that were too large or did not fit in the queue, and ones that did not parse
+	std::atomic<unsigned> mNumDropped{ 0 };
+	std::atomic<unsigned> mNumUnparsed{ 0 };
+};
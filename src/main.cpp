@@ -1,22 +1,28 @@
 //
 //  Main.cpp provided under CC0 license
 //
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
-#include <sstream>
 #include <random>
-#include <glm/gtx/string_cast.hpp>
 #include "sgct/sgct.h"
 
 #include "sgct/profiling.h"
 
 #include "websockethandler.h"
+#include "messagebuffer.hpp"
+#include "relayprotocol.hpp"
+#include "inputqueue.hpp"
 #include "utility.hpp"
 #include "game.hpp"
+#include "simlog.hpp"
+#include "syncstream.hpp"
+#include "syncstats.hpp"
+#include "synclog.hpp"
 #include "modelmanager.hpp"
 #include "inireader.h"
 
@@ -32,8 +38,30 @@ namespace {
 	bool isGameEnded = false, isGameStarted = false;
 	bool areStatsVisible = false;
 
-	//Container for deserialized game state info
-	std::vector<SyncableData> gameObjectStates;
+	//Delta frames of the game state, encoder on master and decoder on clients
+	SyncEncoder syncEncoder;
+	SyncDecoder syncDecoder;
+
+	//Frame sizes and encode or decode times of this node, shown with the stats graph
+	SyncStats syncStats;
+
+	//Log of every frame and websocket message on master, see domedagen_replay
+	SyncRecorder syncRecorder;
+
+	//Simulation time rendered on master, clients animate with it
+	float syncedTime = 0.f;
+
+	//Send collectible spawns and collects instead of collectibles, see SyncEncoder
+	bool syncCollectibleEvents = false;
+
+	//Message format of the protocol the web server picked, set on the thread that
+	//services the websocket
+	std::atomic<RelayProtocol::Format> relayFormat{ RelayProtocol::TEXT };
+
+	//Messages from the web server, parsed where they are received and applied in preSync
+	InputQueue inputQueue{ 4096 };
+	//Microseconds from when a message was received until preSync applied it
+	RollingHistogram inputLatency;
 } // namespace
 
 using namespace sgct;
@@ -56,6 +84,7 @@ void keyboard(Key key, Modifier modifier, Action action, int);
 void connectionEstablished();
 void connectionClosed();
 void messageReceived(const void* data, size_t length);
+void applyInput();
 
 /****************************
 		CONSTANTS
@@ -96,6 +125,15 @@ int main(int argc, char** argv)
 		                       std::stof(constraintConfig["tilt"]));
 	spawnDetails = appConfig["Spawn"];
 	gameConfig = appConfig["Game"];
+	IniGroup syncConfig = appConfig["Sync"];
+		syncEncoder.setKeyframeInterval(std::stoul(syncConfig["keyframeInterval"]));
+		syncEncoder.setPlayerSyncInterval(std::stoul(syncConfig["playerSyncInterval"]));
+		syncCollectibleEvents = syncConfig["collectibleEvents"] == "true";
+		syncEncoder.setCollectibleEvents(syncCollectibleEvents);
+		Player::setCorrection(std::stof(syncConfig["maxCorrection"]),
+		                      std::stof(syncConfig["correctionTime"]));
+	const std::string statsCsv = syncConfig["statsCsv"];
+	const std::string recordFile = syncConfig["recordFile"];
 
 	//Provide functions to engine handles
 	Engine::Callbacks callbacks;
@@ -111,7 +149,6 @@ int main(int argc, char** argv)
 
 	//Initialize engine
 	try {
-		gameObjectStates.reserve(Game::mMAXPLAYERS*3);
 		Engine::create(cluster, callbacks, config);
 	}
 	catch (const std::runtime_error & e) {
@@ -129,7 +166,23 @@ int main(int argc, char** argv)
 			messageReceived
 		);
 		constexpr const int MessageSize = 1024;
-		wsHandler->connect("example-protocol", MessageSize);
+		wsHandler->setBatching(networkConfig["batchMessages"] == "true");
+		//The binary protocol is preferred, servers that don't know it pick the text one
+		wsHandler->connect({ RelayProtocol::BINARY_NAME, RelayProtocol::TEXT_NAME }, MessageSize);
+		//Receive on a thread of its own, so input does not wait for the next frame
+		if (networkConfig["networkThread"] == "true")
+			wsHandler->startServiceThread();
+
+		if (!recordFile.empty() && !syncRecorder.open(recordFile, Game::instance().getSpawnSeed()))
+			Log::Warning("Could not open sync recording %s", recordFile.c_str());
+	}
+
+	//Every node logs its own frames, the node id keeps the files apart
+	if (!statsCsv.empty())
+	{
+		const std::string csvPath = std::to_string(ClusterManager::instance().thisNodeId()) + "_" + statsCsv;
+		if (!syncStats.openCsv(csvPath))
+			Log::Warning("Could not open sync stats file %s", csvPath.c_str());
 	}
 	/**********************************/
 	/*			 Test Area			  */
@@ -145,8 +198,19 @@ int main(int argc, char** argv)
 void initOGL(GLFWwindow*)
 {
 	ModelManager::init();
-	Game::init();
+
+	//Simulation messages go through the sgct log like the rest of the application
+	SimLog::setCallback([](const std::string& message) { Log::Info("%s", message.c_str()); });
+
+	Game::init(std::stoul(gameConfig["maxPlayers"]), std::stoul(gameConfig["maxCollectibles"]));
 	Game::instance().setMaxTime(std::stof(gameConfig["maxTime"]));
+	Game::instance().setTickRate(std::stof(gameConfig["tickRate"]),
+	                             std::stoi(gameConfig["maxCatchUpSteps"]));
+	Game::instance().setNumWorkers(std::stoi(gameConfig["workerThreads"]));
+	Game::instance().setSpawnSchedule(std::stof(gameConfig["spawnInterval"]),
+	                                  std::stoi(gameConfig["spawnSlices"]),
+	                                  std::stof(gameConfig["collectibleLifetime"]));
+	Game::instance().setCollectEventLogging(syncCollectibleEvents && Engine::instance().isMaster());
 
 	/**********************************/
 	/*			 Debug Area			  */
@@ -190,12 +254,28 @@ void draw(const RenderData& data)
 
 void draw2D(const RenderData& data)
 {
-	if (isGameStarted && !isGameEnded)
-		return;
-
 	static constexpr int bigFontSize = 20;
 	static constexpr int smallFontSize = 14;
 
+	//Sync sizes and times next to the stats graph
+	if (areStatsVisible)
+	{
+		text::print(
+			data.window,
+			data.viewport,
+			*text::FontManager::instance().font("SGCTFont", smallFontSize),
+			text::Alignment::TopLeft,
+			smallFontSize,
+			data.window.framebufferResolution().y - 2 * bigFontSize,
+			glm::vec4{ 1.f, 1.f, 1.f, 1.f },
+			"%s%s", syncStats.getSummary().c_str(),
+			inputLatency.getNumSamples() > 0 ? formatHistogram("input latency us", inputLatency).c_str() : ""
+		);
+	}
+
+	if (isGameStarted && !isGameEnded)
+		return;
+
 	const std::string leaderboardString = Game::instance().getLeaderboard();
 	const glm::ivec2& screenRes = data.window.framebufferResolution();
 	if (!isGameStarted) {
@@ -283,7 +363,10 @@ void keyboard(Key key, Modifier modifier, Action action, int)
 
 	if (key == Key::I && (action == Action::Press || action == Action::Repeat))
 	{
-		wsHandler->queueMessage("U start");
+		if (MessageBuffer* message = wsHandler->newMessage()) {
+			RelayProtocol::writeGameState(*message, relayFormat, false);
+			wsHandler->queueMessage(message);
+		}
 
 		isGameStarted = true;
 		Game::instance().startGame();
@@ -299,15 +382,22 @@ void preSync()
 	//Run game simulation on master only
 	if (Engine::instance().isMaster())
 	{
+		applyInput();
+
 		if (!isGameEnded && isGameStarted) {
 			if (Game::instance().shouldSendTime()) {
-				std::string timePassed = std::to_string(Game::instance().getPassedTime());
-				wsHandler->queueMessage("T " + timePassed);
+				if (MessageBuffer* message = wsHandler->newMessage()) {
+					RelayProtocol::writeTime(*message, relayFormat, Game::instance().getPassedTime());
+					wsHandler->queueMessage(message);
+				}
 			}
 			Game::instance().update();
 			if (Game::instance().hasGameEnded()) {
 				if (!isGameEnded) {
-					wsHandler->queueMessage("U end");
+					if (MessageBuffer* message = wsHandler->newMessage()) {
+						RelayProtocol::writeGameState(*message, relayFormat, true);
+						wsHandler->queueMessage(message);
+					}
 					isGameEnded = true;
 				}
 			}
@@ -318,14 +408,20 @@ void preSync()
 
 std::vector<std::byte> encode()
 {
+	//sgct takes the frame by value, so this is the one allocation left per frame
+	//Reserve what encode() asks for behind the header, so serializing never grows it
 	std::vector<std::byte> output;
+	output.reserve(GameFrameHeader::BYTES + syncEncoder.getReserveBytes(Game::instance()));
 
-	serializeObject(output, isGameEnded);
-	serializeObject(output, areStatsVisible);
-	serializeObject(output, isGameStarted);
+	const GameFrameHeader header{ isGameEnded, areStatsVisible, isGameStarted, Game::instance().getRenderTime() };
+	header.write(output);
 
 	//For some reason everything has to to be put in one vector to avoid sgct syncing bugs
-	serializeObject(output, Game::instance().getSyncableData());
+	//Only objects that changed since the last frame are sent, see SyncEncoder
+	syncEncoder.encode(Game::instance(), output);
+	Game::instance().clearCollectEvents();
+	syncStats.add(syncEncoder.getFrameStats());
+	syncRecorder.record(SyncLog::FRAME, Engine::getTime(), ByteSpan(output));
 
 	return output;
 }
@@ -335,10 +431,21 @@ void decode(const std::vector<std::byte>& data, unsigned int pos)
 	if (!Game::exists() || isGameEnded) //No point in syncing data if no Game isnt running
 		return;
 
-	deserializeObject(data, pos, isGameEnded);
-	deserializeObject(data, pos, areStatsVisible);
-	deserializeObject(data, pos, isGameStarted);
-	deserializeObject(data, pos, gameObjectStates);
+	ByteReader input(ByteSpan(data), pos);
+	GameFrameHeader header{};
+	if (!header.read(input))
+		return;
+	isGameEnded = header.mIsGameEnded;
+	areStatsVisible = header.mAreStatsVisible;
+	isGameStarted = header.mIsGameStarted;
+	syncedTime = header.mRenderTime;
+
+	//Players move on to the synced time before the frame corrects them
+	if (isGameStarted && !isGameEnded)
+		Game::instance().setSyncedTime(syncedTime);
+	size_t framePos = input.getPos();
+	syncDecoder.decode(ByteSpan(data), framePos, Game::instance());
+	syncStats.add(syncDecoder.getFrameStats());
 }
 
 void cleanup()
@@ -349,87 +456,100 @@ void cleanup()
 
 void postSyncPreDraw()
 {
-	//Sync gameobjects' state on clients only
+	//Game objects on clients were already synced in decode()
 	if (!Engine::instance().isMaster() && Game::exists())
 	{
 		Engine::instance().setStatsGraphVisibility(areStatsVisible);
-
-		if (!isGameStarted || isGameEnded)
-			return;
-		else if(gameObjectStates.size() > 0 && !isGameEnded) {
-			Game::instance().setSyncableData(std::move(gameObjectStates));
-		}
 	}
 	else
 	{
 		if (isGameStarted)
-			Game::instance().sendPointsToServer(wsHandler);
+			Game::instance().sendPointsToServer(wsHandler, relayFormat);
 	}
 }
 
 void connectionEstablished()
 {
-	Log::Info("Connection established");
+	relayFormat = wsHandler->protocol() == RelayProtocol::BINARY_NAME
+		? RelayProtocol::BINARY : RelayProtocol::TEXT;
+	wsHandler->setBinary(relayFormat == RelayProtocol::BINARY);
+	Log::Info("Connection established using %s", wsHandler->protocol().c_str());
 }
 
 void connectionClosed()
 {
-	Log::Info("Connection closed");
+	Log::Info("Connection closed, %u messages from the server were dropped and %u did not parse",
+	          inputQueue.getNumDropped(), inputQueue.getNumUnparsed());
 }
 
 void messageReceived(const void* data, size_t length)
 {
-	std::string_view msg = std::string_view(reinterpret_cast<const char*>(data), length);
-	//Log::Info("Message received: %s", msg.data());
+	//Called where the websocket is serviced, which is the network thread if there is one
+	const ByteSpan bytes(static_cast<const std::byte*>(data), length);
+	//Messages that don't parse are counted by the queue, the server also sends plain text
+	if (inputQueue.push(bytes, relayFormat, Engine::getTime()) == InputQueue::DROPPED)
+		Log::Warning("Dropped message from the server, the input queue is full or the message is too large");
+}
 
-	std::string message = msg.data();
+void applyInput()
+{
+	ZoneScoped;
 
-	if (!message.empty())
+	const double now = Engine::getTime();
+	const RelayProtocol::Format format = relayFormat;
+	while (const InputEvent* event = inputQueue.front())
 	{
-		//Get an easily manipulated stream of the message and read type of message
-		std::istringstream iss(message);
-		char msgType;
-		iss >> msgType;
-
-		// If first slot is 'N', a name and unique ID has been sent
-		if (msgType == 'N') {
-			Log::Info("Player connected: %s", message.c_str());
-			Game::instance().addPlayer(Utility::getNewPlayerData(iss));
-		}
+		inputLatency.add((now - event->mArrivalTime) * 1e6);
+		syncRecorder.record(format == RelayProtocol::BINARY ? SyncLog::BINARY_MESSAGE : SyncLog::MESSAGE,
+		                    event->mArrivalTime, event->getBytes());
 
-		// If first slot is 'C', the rotation angle has been sent
-		if (msgType == 'C') {
-			Game::instance().updateTurnSpeed(Utility::getTurnSpeed(iss));
+		const RelayProtocol::Message& message = event->mMessage;
+		switch (message.mType)
+		{
+		// A name and unique ID has been sent
+		case RelayProtocol::JOIN:
+			Log::Info("Player connected: %u %.*s", message.mId,
+			          static_cast<int>(message.mName.size()), message.mName.data());
+			Game::instance().addPlayer(std::make_tuple(message.mId, std::string(message.mName)));
+			break;
+
+		// The rotation angle has been sent
+		case RelayProtocol::TURN:
+			Game::instance().updateTurnSpeed(std::make_tuple(message.mId, message.mTurnSpeed));
+			break;
+
+		// Player to be deleted has been sent
+		case RelayProtocol::DISABLE:
+			Log::Info("Player disabled: %u", message.mId);
+			Game::instance().disablePlayer(message.mId);
+			break;
+
+		// Player to be enabled has been sent
+		case RelayProtocol::ENABLE:
+			Log::Info("Player enabled: %u", message.mId);
+			Game::instance().enablePlayer(message.mId);
+			break;
+
+		// Player's ID has been sent, send colour information back to server
+		case RelayProtocol::COLOURS_REQUEST:
+		{
+			std::pair<glm::vec3, glm::vec3> colours = Game::instance().getPlayerColours(message.mId);
+			if (MessageBuffer* colourOne = wsHandler->newMessage()) {
+				RelayProtocol::writeColour(*colourOne, format, RelayProtocol::COLOUR_ONE,
+				                           message.mId, colours.first);
+				wsHandler->queueMessage(colourOne);
+			}
+			if (MessageBuffer* colourTwo = wsHandler->newMessage()) {
+				RelayProtocol::writeColour(*colourTwo, format, RelayProtocol::COLOUR_TWO,
+				                           message.mId, colours.second);
+				wsHandler->queueMessage(colourTwo);
+			}
+			break;
 		}
 
-
-        // If first slot is 'D', player to be deleted has been sent
-        if (msgType == 'D') {
-            unsigned int playerId;
-            iss >> playerId;
-            Log::Info("Player disabled: %s", message.c_str());
-            Game::instance().disablePlayer(playerId);
-        }
-
-        // If first slot is 'E', player to be enabled has been sent
-        if (msgType == 'E') {
-            Log::Info("Player enabled: %s", message.c_str());
-            unsigned int playerId;
-            iss >> playerId;
-            Game::instance().enablePlayer(playerId);
-        }
-
-        // If first slot is 'I', player's ID has been sent
-        if (msgType == 'I') {
-            unsigned int playerId;
-            iss >> playerId;
-            // Send colour information back to server
-            std::pair<glm::vec3, glm::vec3> colours = Game::instance().getPlayerColours(playerId);
-            std::string colourOne = glm::to_string(colours.first);
-            std::string colourTwo = glm::to_string(colours.second);
-
-            wsHandler->queueMessage("A " + colourOne + " " + std::to_string(playerId));
-            wsHandler->queueMessage("B " + colourTwo + " " + std::to_string(playerId));
-        }
+		default:
+			break;
+		}
+		inputQueue.pop();
 	}
 }
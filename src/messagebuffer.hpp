@@ -0,0 +1,69 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "bytestream.hpp"
+
+//Bytes of one outbound message with room reserved in front of them
+//The network layer writes its frame header into the headroom, so a message is sent
+//from where it was formatted. Clearing keeps the memory, a reused buffer only
+//allocates if a message outgrows every message it held before
+class MessageBuffer
+{
+public:
+	MessageBuffer(size_t headroom = 0, size_t capacity = 0)
+		: mHeadroom{ headroom }
+	{
+		mBytes.reserve(headroom + capacity);
+		mBytes.resize(headroom);
+	}
+
+	void clear() { mBytes.resize(mHeadroom); }
+
+	void append(const void* data, size_t size)
+	{
+		const size_t oldSize = mBytes.size();
+		mBytes.resize(oldSize + size);
+		if (size > 0)
+			std::memcpy(mBytes.data() + oldSize, data, size);
+	}
+
+	void append(std::string_view text) { append(text.data(), text.size()); }
+
+	//Decimal text of value, like std::to_string
+	template<typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+	void appendNumber(T value)
+	{
+		char text[24];
+		const std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+		append(text, static_cast<size_t>(result.ptr - text));
+	}
+
+	void appendNumber(float value)
+	{
+		char text[64];
+		const int length = std::snprintf(text, sizeof(text), "%f", value);
+		append(text, length > 0 ? static_cast<size_t>(length) : 0);
+	}
+
+	//Accessors, the data starts after the headroom
+	std::byte* getData() { return mBytes.data() + mHeadroom; }
+	const std::byte* getData() const { return mBytes.data() + mHeadroom; }
+	size_t getSize() const { return mBytes.size() - mHeadroom; }
+	size_t getHeadroom() const { return mHeadroom; }
+	ByteSpan getBytes() const { return ByteSpan(getData(), getSize()); }
+
+private:
+	std::vector<std::byte> mBytes;
+	size_t mHeadroom;
+
+	//Position in the MessageRing the buffer was claimed for
+	size_t mRingPos = 0;
+	friend class MessageRing;
+};
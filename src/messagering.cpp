@@ -0,0 +1,100 @@
+#include "messagering.hpp"
+
+#include <algorithm>
+
+namespace {
+	size_t nextPowerOfTwo(size_t value)
+	{
+		size_t result = 1;
+		while (result < value)
+			result <<= 1;
+		return result;
+	}
+} // namespace
+
+MessageRing::MessageRing(size_t numSlots, size_t slotBytes, size_t headroom)
+	: mMask(nextPowerOfTwo(std::max<size_t>(numSlots, 2)) - 1)
+{
+	mSlots = std::make_unique<Slot[]>(mMask + 1);
+	for (size_t i = 0; i <= mMask; ++i)
+	{
+		mSlots[i].mSequence.store(i, std::memory_order_relaxed);
+		mSlots[i].mBuffer = MessageBuffer(headroom, slotBytes);
+	}
+}
+
+MessageBuffer* MessageRing::claim()
+{
+	//Claim a position by moving mPushPos past it, the slot is then ours until committed
+	size_t pos = mPushPos.load(std::memory_order_relaxed);
+	Slot* slot;
+	while (true)
+	{
+		slot = &mSlots[pos & mMask];
+		const size_t sequence = slot->mSequence.load(std::memory_order_acquire);
+		const ptrdiff_t lap = static_cast<ptrdiff_t>(sequence - pos);
+		if (lap == 0)
+		{
+			if (mPushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (lap < 0)
+			return nullptr; //The consumer has not popped this slot since the last lap
+		else
+			pos = mPushPos.load(std::memory_order_relaxed);
+	}
+
+	slot->mBuffer.clear();
+	slot->mBuffer.mRingPos = pos;
+	return &slot->mBuffer;
+}
+
+void MessageRing::commit(MessageBuffer* buffer)
+{
+	const size_t pos = buffer->mRingPos;
+	mSlots[pos & mMask].mSequence.store(pos + 1, std::memory_order_release);
+}
+
+bool MessageRing::push(const void* data, size_t size)
+{
+	MessageBuffer* buffer = claim();
+	if (!buffer)
+		return false;
+
+	buffer->append(data, size);
+	commit(buffer);
+	return true;
+}
+
+MessageBuffer* MessageRing::front() const
+{
+	return peek(0);
+}
+
+MessageBuffer* MessageRing::peek(size_t index) const
+{
+	if (index > mMask)
+		return nullptr;
+
+	const size_t pos = mPopPos.load(std::memory_order_relaxed) + index;
+	Slot& slot = mSlots[pos & mMask];
+	if (slot.mSequence.load(std::memory_order_acquire) != pos + 1)
+		return nullptr;
+
+	return &slot.mBuffer;
+}
+
+void MessageRing::pop()
+{
+	const size_t pos = mPopPos.load(std::memory_order_relaxed);
+	//Hand the slot to the producers of the next lap
+	mSlots[pos & mMask].mSequence.store(pos + mMask + 1, std::memory_order_release);
+	mPopPos.store(pos + 1, std::memory_order_relaxed);
+}
+
+size_t MessageRing::size() const
+{
+	const size_t popPos = mPopPos.load(std::memory_order_relaxed);
+	const size_t pushPos = mPushPos.load(std::memory_order_relaxed);
+	return pushPos > popPos ? pushPos - popPos : 0;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "messagebuffer.hpp"
+
+//Bounded queue of byte messages that any number of threads push to and one thread pops
+//Every slot holds a MessageBuffer that is allocated up front and reused, so queueing a
+//message that fits allocates nothing and popping never moves the messages behind it
+//Pushing never waits for a lock, a full ring rejects the message instead
+class MessageRing
+{
+public:
+	//numSlots is rounded up to a power of two. Every buffer keeps headroom bytes free in
+	//front of its message and has room for slotBytes more
+	MessageRing(size_t numSlots, size_t slotBytes, size_t headroom = 0);
+
+	MessageRing(const MessageRing&) = delete;
+	MessageRing& operator=(const MessageRing&) = delete;
+
+	//Empty buffer of the next free slot to write a message into, nullptr if every slot
+	//is taken. Any thread. The buffer has to be passed to commit() right after it is
+	//written, the consumer cannot pop past it before that
+	MessageBuffer* claim();
+
+	//Hand a buffer from claim() to the consumer
+	void commit(MessageBuffer* buffer);
+
+	//Copy size bytes into the next free slot, false if every slot is taken. Any thread
+	bool push(const void* data, size_t size);
+
+	//Oldest message, nullptr if there is none. It stays valid until pop() and may be
+	//written to, including its headroom. Consumer thread only
+	MessageBuffer* front() const;
+
+	//Message index places behind the oldest one, nullptr if there is none
+	//Consumer thread only
+	MessageBuffer* peek(size_t index) const;
+
+	//Free the slot of the oldest message, only after front() returned it
+	//Consumer thread only
+	void pop();
+
+	//Messages pushed and not yet popped, exact only on the consumer thread
+	size_t size() const;
+	//Consumer thread only
+	bool empty() const { return front() == nullptr; }
+
+	//Accessors
+	size_t getCapacity() const { return mMask + 1; }
+
+private:
+	//Padded to a cache line so threads working on neighbouring slots do not contend
+	struct alignas(64) Slot
+	{
+		//Lap of the ring this slot is in, tells producers and the consumer whose turn it is
+		//Free for position p when equal to p, holds the message of p when equal to p + 1
+		std::atomic<size_t> mSequence;
+		MessageBuffer mBuffer;
+	};
+
+	std::unique_ptr<Slot[]> mSlots;
+	size_t mMask;
+
+	//Next position to push and pop, on their own cache lines
+	alignas(64) std::atomic<size_t> mPushPos{ 0 };
+	alignas(64) std::atomic<size_t> mPopPos{ 0 };
+};
@@ -1,70 +1,61 @@
 #include "player.hpp"
+#include<cmath>
 #include<glm/common.hpp>
+#include<glm/gtc/constants.hpp>
 #include<glm/gtx/string_cast.hpp>
 #include<iostream>
 
 #include"balljointconstraint.hpp"
 #include"constants.hpp"
+#include"simlog.hpp"
 
 // Note that these can be set by setConstraints(...)
 float Player::mFOV = 163.0f;
 float Player::mTILT = 0.0f;
+float Player::mMaxCorrection = 0.1f;
+float Player::mCorrectionTime = 0.25f;
 
 Player::ColourSelector Player::mColourSelector = Player::ColourSelector{ };
 
 Player::Player()
 	: GameObject{ GameObject::PLAYER, DOMERADIUS, glm::quat(glm::vec3(0.f)), 0.f, PLAYERSCALE },
-	  GeometryHandler("player", "diver"),
 	  mName{ "temp" },
 	  mPlayerColours{ mColourSelector.getNextPair() },
 	  mConstraint{ mFOV, mTILT },
 	  mSpeed{0.5f}
 {
-	sgct::Log::Info("Player with name=\"%s\" created", mName.c_str());
-	setShaderData();
+	SimLog::info("Player with name=\"" + mName + "\" created");
+	resetInterpolation();
 }
 
 Player::Player(const std::string name, const glm::quat& pos)
 	: GameObject{ GameObject::PLAYER, DOMERADIUS, pos, 0.f, PLAYERSCALE },
-	  GeometryHandler("player", "diver"),
 	  mName{ name },
 	  mPlayerColours{ mColourSelector.getNextPair() },
 	  mConstraint{ mFOV, mTILT }
 {
-	sgct::Log::Info("Player with name=\"%s\" created", mName.c_str());
-	setShaderData();
+	SimLog::info("Player with name=\"" + mName + "\" created");
+	resetInterpolation();
 }
 
-Player::Player(const std::string & objectModelName, float radius,
-	           const glm::quat & position, float orientation,
+Player::Player(float radius, const glm::quat & position, float orientation,
 	           const std::string & name, float speed)
 	: GameObject{ GameObject::PLAYER, radius, position, orientation, PLAYERSCALE },
-	  GeometryHandler("player", objectModelName),
 	  mName { name },
 	  mSpeed{ speed },
 	  mPlayerColours{ mColourSelector.getNextPair() },
 	  mConstraint{ mFOV, mTILT }
 {
-	sgct::Log::Info("Player with name=\"%s\" created", mName.c_str());
-	setShaderData();
+	SimLog::info("Player with name=\"" + mName + "\" created");
+	resetInterpolation();
 }
 
-Player::Player(const PlayerData& newPlayerData,
+Player::Player(const PlayerMetadata& newMetadata,
 	const PositionData& newPosData)
-	: GameObject{ GameObject::PLAYER, newPosData.mRadius, glm::quat{}, 0.f, PLAYERSCALE },
-	GeometryHandler("player", "diver"),
-	mName{ std::string(newPlayerData.mNameLength, ' ') },
-	mPoints{ newPlayerData.mPoints },
-	mIsAlive{ newPlayerData.mIsAlive },
-	mSpeed{ newPlayerData.mSpeed },
+	: GameObject{ GameObject::PLAYER, newPosData.mRadius, glm::quat{}, newPosData.mOrientation, PLAYERSCALE },
+	mName{ newMetadata.mPlayerName, std::min(newMetadata.mNameLength, NAMELIMIT) },
 	mConstraint{ mFOV, mTILT }
 {
-	//Copy new player name
-	for (size_t i = 0; i < newPlayerData.mNameLength; i++)
-	{
-		mName[i] = newPlayerData.mPlayerName[i];
-	}
-
 	glm::quat temp{};
 		temp.w = newPosData.mW;
 		temp.x = newPosData.mX;
@@ -72,31 +63,35 @@ Player::Player(const PlayerData& newPlayerData,
 		temp.z = newPosData.mZ;
 	setPosition(temp);
 
-	mShaderProgram.unbind();
-	sgct::Log::Info("Player with name=\"%s\" created", mName.c_str());	
+	SimLog::info("Player with name=\"" + mName + "\" created");	
 
-	auto& col = newPlayerData.mPlayerColours;
-	mPlayerColours = std::make_pair(glm::vec3(col.mR1, col.mG1, col.mB1),
-	                                glm::vec3(col.mR2, col.mG2, col.mB2));
-	setShaderData();
+	setMetadata(newMetadata);
+	resetInterpolation();
 }
 
 Player::~Player()
 {
-	sgct::Log::Info("Player with name=\"%s\" removed", mName.c_str());
+	SimLog::info("Player with name=\"" + mName + "\" removed");
 }
 
-PlayerData Player::getPlayerData(bool isNewPlayer) const
+PlayerData Player::getPlayerData() const
 {
 	PlayerData temp;
-	temp.mNewPlayer = isNewPlayer;
-	temp.mNameLength = getName().length();
-
-	//Game state data
 	temp.mPoints = getPoints();
 	temp.mIsAlive = isAlive();
-	temp.mEnabled = isEnabled();
 	temp.mSpeed = getSpeed();
+	return temp;
+}
+
+PlayerMetadata Player::getMetadata() const
+{
+	PlayerMetadata temp;
+	temp.mVersion = mMetadataVersion;
+	temp.mEnabled = isEnabled();
+
+	//Copy name, cut to what fits
+	temp.mNameLength = std::min(static_cast<unsigned>(mName.length()), NAMELIMIT);
+	mName.copy(temp.mPlayerName, temp.mNameLength);
 
 	//Color data
 	glm::vec3 color1 = mPlayerColours.first;
@@ -108,20 +103,29 @@ PlayerData Player::getPlayerData(bool isNewPlayer) const
 		temp.mPlayerColours.mG2 = color2.g;
 		temp.mPlayerColours.mB2 = color2.b;
 
-	//Send name if this is a new player not present on nodes yet
-	if (temp.mNewPlayer)
-	{
-		for (size_t i = 0; i < mName.length(); i++)
-		{
-			temp.mPlayerName[i] = mName.c_str()[i];
-		}
-	}
-
 	return temp;
 }
 
+void Player::setMetadata(const PlayerMetadata& newMetadata)
+{
+	//Names are fixed once a player has joined
+	if (mName.empty())
+		mName.assign(newMetadata.mPlayerName, std::min(newMetadata.mNameLength, NAMELIMIT));
+
+	mEnabled = newMetadata.mEnabled;
+	mMetadataVersion = newMetadata.mVersion;
+
+	auto& col = newMetadata.mPlayerColours;
+	mPlayerColours = std::make_pair(glm::vec3(col.mR1, col.mG1, col.mB1),
+	                                glm::vec3(col.mR2, col.mG2, col.mB2));
+}
+
 void Player::setPlayerData(const PlayerData& newPlayerData, const PositionData& newPosData)
 {
+	//What is rendered before the new state is applied
+	const glm::quat shownPosition = mCorrection * getPosition();
+	const float shownOrientation = getOrientation() + mOrientationCorrection;
+
 	//Position data
 	setOrientation(newPosData.mOrientation);
 	setRadius(newPosData.mRadius);
@@ -136,16 +140,28 @@ void Player::setPlayerData(const PlayerData& newPlayerData, const PositionData&
 	setPosition(newPosition);
 
 	//Game state data
-	setSpeed(newPlayerData.mSpeed);
 	setPoints(newPlayerData.mPoints);
 	setIsAlive(newPlayerData.mIsAlive);
-	setEnabled(newPlayerData.mEnabled);
 	setSpeed(newPlayerData.mSpeed);
+
+	//Keep rendering the old state and fade to the new one, unless it is too far off
+	mCorrection = shownPosition * glm::inverse(newPosition);
+	mOrientationCorrection = std::remainder(shownOrientation - newPosData.mOrientation, glm::two_pi<float>());
+	const float positionError = 2.f * std::acos(std::min(1.f, std::abs(mCorrection.w)));
+	if (positionError > mMaxCorrection || std::abs(mOrientationCorrection) > mMaxCorrection)
+	{
+		mCorrection = glm::quat(1.f, 0.f, 0.f, 0.f);
+		mOrientationCorrection = 0.f;
+	}
+
+	//Synced state is already interpolated on master
+	resetInterpolation();
 }
 
 void Player::update(float deltaTime)
 {
-  if (!mEnabled)
+	resetInterpolation();
+	if (!mEnabled)
 		return;  
 	float oldOrient = getOrientation();
 	setOrientation(oldOrient + deltaTime * mTurnSpeed);	
@@ -159,36 +175,43 @@ void Player::update(float deltaTime)
 	setPosition(glm::normalize(newPos));
 }
 
-void Player::render(const glm::mat4& mvp, const glm::mat4& v) const
+void Player::extrapolate(float deltaTime)
 {
-	if (!mEnabled)
-		return;
+	update(deltaTime);
 
-	// frans; Even more color things!
-	glUniform3fv(mPrimaryColLoc, 1, glm::value_ptr(mPlayerColours.first));
-	glUniform3fv(mSecondaryColLoc, 1, glm::value_ptr(mPlayerColours.second));
+	const float keep = mCorrectionTime > 0.f ? std::exp(-deltaTime / mCorrectionTime) : 0.f;
+	mCorrection = glm::slerp(glm::quat(1.f, 0.f, 0.f, 0.f), mCorrection, keep);
+	mOrientationCorrection *= keep;
+}
+
+glm::quat Player::getInterpolatedPosition(float alpha) const
+{
+	return mCorrection * glm::slerp(mPreviousPosition, getPosition(), alpha);
+}
 
-	glm::vec3 cameraPos = glm::vec3((inverse(v))[3]);
-	//std::cout << cameraPos.x << ' ' << cameraPos.y << ' ' << cameraPos.z << '\n';
-	glUniform3fv(mCameraPosLoc, 1, glm::value_ptr(cameraPos));
+float Player::getInterpolatedOrientation(float alpha) const
+{
+	return glm::mix(mPreviousOrientation, getOrientation(), alpha) + mOrientationCorrection;
+}
 
-	glm::mat4 transformation = getTransformation();
-	glm::mat3 normalMatrix(glm::transpose(glm::inverse(transformation)));
+PositionData Player::getInterpolatedPositionData(float alpha) const
+{
+	PositionData temp = getPositionData();
+	temp.mOrientation = getInterpolatedOrientation(alpha);
 
-	glUniformMatrix3fv(mNormalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-	glUniformMatrix4fv(mMvpMatrixLoc, 1, GL_FALSE, glm::value_ptr(mvp));
-	glUniformMatrix4fv(mViewMatrixLoc, 1, GL_FALSE, glm::value_ptr(v));
-	glUniformMatrix4fv(mTransMatrixLoc, 1, GL_FALSE, glm::value_ptr(transformation));
+	const glm::quat position = getInterpolatedPosition(alpha);
+	temp.mW = position.w;
+	temp.mX = position.x;
+	temp.mY = position.y;
+	temp.mZ = position.z;
 
-	renderModel();
+	return temp;
 }
 
-void Player::setShaderData()
+void Player::resetInterpolation()
 {
-	GeometryHandler::setShaderData();
-	// frans; More color things
-	mPrimaryColLoc = glGetUniformLocation(mShaderProgram.id(), "primaryCol");
-	mSecondaryColLoc = glGetUniformLocation(mShaderProgram.id(), "secondaryCol");
+	mPreviousPosition = getPosition();
+	mPreviousOrientation = getOrientation();
 }
 
 Player::ColourSelector::ColourSelector()
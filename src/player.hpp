@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -8,29 +9,32 @@
 #include <random>
 #include <chrono>
 
-#include "sgct/log.h"
-
 #include "gameobject.hpp"
-#include "geometryhandler.hpp"
 #include "balljointconstraint.hpp"
 
-//POD struct to encode/decode game state data
+//POD structs to encode/decode game state data
 //Ctor, initialisation disallowed to KEEP IT POD
 constexpr unsigned NAMELIMIT = 20;
 
+//Game state data, synced in every frame it changes in
 struct PlayerData
 {
 public:
-	//Game state data
 	int   mPoints;
-	bool  mEnabled;
 	bool  mIsAlive;
 	float mSpeed;
+};
+
+//Rarely changing player data, only synced when mVersion changes
+struct PlayerMetadata
+{
+public:
+	//Grows on master every time one of the fields below changes
+	uint32_t mVersion;
+	bool mEnabled;
 
-	//These are only used when a new player is created on nodes
-	//C-style array because of POD
+	//C-style array because of POD, names longer than NAMELIMIT are cut
 	char mPlayerName[NAMELIMIT];
-	bool mNewPlayer;
 	unsigned mNameLength;
 
 	//Color data
@@ -41,7 +45,7 @@ public:
 	} mPlayerColours;
 };
 
-class Player : public GameObject, private GeometryHandler
+class Player : public GameObject
 {
 public:
 	//Default ctor used for debugging
@@ -51,12 +55,11 @@ public:
 	Player(const std::string name, const glm::quat& pos);
 
 	//Big ctor
-	Player(const std::string & objectModelName, float radius, 
-		   const glm::quat& position, float orientation,
+	Player(float radius, const glm::quat& position, float orientation,
 		   const std::string& name, float speed);
 
-	//Ctor from positiondata (syncing new players on nodes)
-	Player(const PlayerData& newPlayerData,
+	//Ctor from metadata and positiondata (syncing new players on nodes)
+	Player(const PlayerMetadata& newMetadata,
 		const PositionData& newPosData);
 
 	//Dtor
@@ -67,19 +70,29 @@ public:
 	Player& operator=(const Player&) = delete;
 
 	//Get/set playerdata during synchronisation
-	PlayerData getPlayerData(bool isNewPlayer) const;
+	PlayerData getPlayerData() const;
 	void setPlayerData(const PlayerData& newPlayerData,
 					   const PositionData& newPosData);
 
-	//Update position
+	//Get/set name, colours and enabled state, only synced when the version changes
+	PlayerMetadata getMetadata() const;
+	void setMetadata(const PlayerMetadata& newMetadata);
+
+	//Update position, the state before the update is kept for interpolation
 	void update(float deltaTime) override;
 
-	//Render obejct
-	void render(const glm::mat4& mvp, const glm::mat4& v) const override;
+	//Render nodes move players like update() between the frames master syncs them in
+	//Also fades out the jump to the last synced state, see setCorrection
+	void extrapolate(float deltaTime);
+
+	//State blended between the previous and the current update, alpha in [0, 1]
+	glm::quat getInterpolatedPosition(float alpha) const;
+	float getInterpolatedOrientation(float alpha) const;
+	PositionData getInterpolatedPositionData(float alpha) const;
 
 	//Activator + deactivator	
-	void enablePlayer() { mEnabled = true; }
-	void disablePlayer() { mEnabled = false; }
+	void enablePlayer() { setEnabled(true); }
+	void disablePlayer() { setEnabled(false); }
 
 	//Accessors
 	float getSpeed() const { return mSpeed; };
@@ -88,13 +101,14 @@ public:
 	const bool isAlive() const { return mIsAlive; };
 	const bool isEnabled() const { return mEnabled; };
 	const std::string& getName() const { return mName; };
+	uint32_t getMetadataVersion() const { return mMetadataVersion; }
     
     // Iris: trying to send colours
     std::pair<glm::vec3, glm::vec3> getColours() const { return mPlayerColours; };
 
 	//Mutators
 	void addPoints() { mPoints += 10; }
-	void setEnabled(bool state) { mEnabled = state; }
+	void setEnabled(bool state) { if (state != mEnabled) mEnabled = state, ++mMetadataVersion; }
 	void setSpeed(float speed) override { mSpeed = speed; };
 	void setPoints(int points) { mPoints = points; };
 	void setIsAlive(bool isAlive) { mIsAlive = isAlive; };
@@ -103,6 +117,10 @@ public:
 	//Static methods
 	static void setConstraints(float fov, float tilt) { mFOV = fov, mTILT = tilt; }
 
+	//A synced state at most maxAngle radians from the extrapolated one is faded in
+	//over duration seconds, larger errors snap to the synced state
+	static void setCorrection(float maxAngle, float duration) { mMaxCorrection = maxAngle, mCorrectionTime = duration; }
+
 private:
 	//Player information/data
 	float mTurnSpeed = 0.2f;
@@ -113,9 +131,15 @@ private:
 	std::string mName;
 
 	// frans; Trying something with colors
-	std::pair<glm::vec3, glm::vec3> mPlayerColours;	
-	GLint mPrimaryColLoc = -1;
-	GLint mSecondaryColLoc = -1;
+	std::pair<glm::vec3, glm::vec3> mPlayerColours;
+
+	//State before the last update, used for render interpolation
+	glm::quat mPreviousPosition;
+	float mPreviousOrientation = 0.f;
+
+	//Offset from the simulated to the rendered state on render nodes, fades to none
+	glm::quat mCorrection = glm::quat(1.f, 0.f, 0.f, 0.f);
+	float mOrientationCorrection = 0.f;
 
 	struct ColourSelector
 	{
@@ -154,10 +178,17 @@ private:
 	//If person disconnect/reconnect
 	bool mEnabled = true;
 
+	//Version of the name, colours and enabled state, see PlayerMetadata
+	uint32_t mMetadataVersion = 1;
+
 	//Constants for initializing mConstraint
 	static float mFOV;
 	static float mTILT;
 
-	//Specializes setShaderData() from GeometryHandler
-	void setShaderData();
+	//See setCorrection
+	static float mMaxCorrection;
+	static float mCorrectionTime;
+
+	//Forget the previous state, e.g. after a teleport or sync
+	void resetInterpolation();
 };
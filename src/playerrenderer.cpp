@@ -0,0 +1,49 @@
+#include "playerrenderer.hpp"
+
+PlayerRenderer::PlayerRenderer()
+	: GeometryHandler{ "player", "diver" }
+{
+	setShaderData();
+	// frans; More color things
+	mPrimaryColLoc = glGetUniformLocation(mShaderProgram.id(), "primaryCol");
+	mSecondaryColLoc = glGetUniformLocation(mShaderProgram.id(), "secondaryCol");
+}
+
+void PlayerRenderer::render(const std::vector<Player>& players, const glm::mat4& mvp,
+                            const glm::mat4& v, float alpha) const
+{
+	ZoneScoped;
+	if (players.empty())
+		return;
+
+	mShaderProgram.bind();
+
+	//Uniforms shared by all players
+	glm::vec3 cameraPos = glm::vec3((inverse(v))[3]);
+	glUniform3fv(mCameraPosLoc, 1, glm::value_ptr(cameraPos));
+	glUniformMatrix4fv(mMvpMatrixLoc, 1, GL_FALSE, glm::value_ptr(mvp));
+	glUniformMatrix4fv(mViewMatrixLoc, 1, GL_FALSE, glm::value_ptr(v));
+
+	for (const Player& player : players)
+	{
+		if (!player.isEnabled())
+			continue;
+
+		// frans; Even more color things!
+		const std::pair<glm::vec3, glm::vec3> colours = player.getColours();
+		glUniform3fv(mPrimaryColLoc, 1, glm::value_ptr(colours.first));
+		glUniform3fv(mSecondaryColLoc, 1, glm::value_ptr(colours.second));
+
+		glm::mat4 transformation = GameObject::composeTransformation(
+			player.getInterpolatedPosition(alpha), player.getRadius(),
+			player.getInterpolatedOrientation(alpha), player.getScale(), player.getModelRotation());
+		glm::mat3 normalMatrix(glm::transpose(glm::inverse(transformation)));
+
+		glUniformMatrix3fv(mNormalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+		glUniformMatrix4fv(mTransMatrixLoc, 1, GL_FALSE, glm::value_ptr(transformation));
+
+		renderModel();
+	}
+
+	mShaderProgram.unbind();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+#include "sgct/profiling.h"
+
+#include "geometryhandler.hpp"
+#include "player.hpp"
+
+//Draws all enabled players with the player shader
+//Players only store simulation state, shader and uniform locations are shared here
+class PlayerRenderer : private GeometryHandler
+{
+public:
+	PlayerRenderer();
+
+	//Render enabled players blended alpha of the way from their previous to current update
+	void render(const std::vector<Player>& players, const glm::mat4& mvp, const glm::mat4& v,
+	            float alpha) const;
+
+private:
+	GLint mPrimaryColLoc = -1;
+	GLint mSecondaryColLoc = -1;
+};
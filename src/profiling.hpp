@@ -0,0 +1,11 @@
+#pragma once
+
+//Profiling zones for code in the simulation library
+//When the application is built the zones come from SGCT's Tracy integration,
+//headless builds have no SGCT so the zones compile to nothing
+#ifdef DOMEDAGEN_SGCT_PROFILING
+#include "sgct/profiling.h"
+#else
+#define ZoneScoped
+#define ZoneScopedN(name)
+#endif
@@ -0,0 +1,275 @@
+#include "relayprotocol.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+	using namespace RelayProtocol;
+
+	//Text is split at spaces without copying, like operator>> on a stream
+	class TextReader
+	{
+	public:
+		TextReader(ByteSpan data)
+			: mCursor{ reinterpret_cast<const char*>(data.mData) }
+			, mEnd{ mCursor + data.mSize }
+		{}
+
+		bool readWord(std::string_view& word)
+		{
+			while (mCursor < mEnd && *mCursor == ' ')
+				++mCursor;
+			const char* begin = mCursor;
+			while (mCursor < mEnd && *mCursor != ' ' && *mCursor != '\0')
+				++mCursor;
+			word = std::string_view(begin, static_cast<size_t>(mCursor - begin));
+			return !word.empty();
+		}
+
+		bool read(unsigned& value)
+		{
+			std::string_view word;
+			if (!readWord(word))
+				return false;
+			const std::from_chars_result result = std::from_chars(word.data(), word.data() + word.size(), value);
+			return result.ec == std::errc() && result.ptr == word.data() + word.size();
+		}
+
+		bool read(float& value)
+		{
+			//strtof needs a terminated string, turn speeds are short
+			std::string_view word;
+			char text[32];
+			if (!readWord(word) || word.size() >= sizeof(text))
+				return false;
+			std::memcpy(text, word.data(), word.size());
+			text[word.size()] = '\0';
+			char* end = nullptr;
+			value = std::strtof(text, &end);
+			return end == text + word.size();
+		}
+
+	private:
+		const char* mCursor;
+		const char* mEnd;
+	};
+
+	class BinaryReader
+	{
+	public:
+		BinaryReader(ByteSpan data) : mCursor{ data.mData }, mEnd{ data.mData + data.mSize } {}
+
+		bool readVarint(uint32_t& value)
+		{
+			value = 0;
+			for (unsigned shift = 0; shift < 35 && mCursor < mEnd; shift += 7)
+			{
+				const uint8_t byte = static_cast<uint8_t>(*mCursor++);
+				value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+				if (!(byte & 0x80))
+					return true;
+			}
+			return false;
+		}
+
+		bool readZigzag(int32_t& value)
+		{
+			uint32_t encoded;
+			if (!readVarint(encoded))
+				return false;
+			value = static_cast<int32_t>(encoded >> 1) ^ -static_cast<int32_t>(encoded & 1);
+			return true;
+		}
+
+		bool readText(std::string_view& text, size_t size)
+		{
+			if (size > static_cast<size_t>(mEnd - mCursor))
+				return false;
+			text = std::string_view(reinterpret_cast<const char*>(mCursor), size);
+			mCursor += size;
+			return true;
+		}
+
+	private:
+		const std::byte* mCursor;
+		const std::byte* mEnd;
+	};
+
+	void appendByte(MessageBuffer& buffer, uint8_t value)
+	{
+		buffer.append(&value, 1);
+	}
+
+	void appendVarint(MessageBuffer& buffer, uint32_t value)
+	{
+		uint8_t bytes[5];
+		size_t size = 0;
+		do
+		{
+			bytes[size] = static_cast<uint8_t>(value & 0x7F);
+			value >>= 7;
+			if (value)
+				bytes[size] |= 0x80;
+			++size;
+		} while (value);
+		buffer.append(bytes, size);
+	}
+
+	void appendZigzag(MessageBuffer& buffer, int32_t value)
+	{
+		appendVarint(buffer, (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31));
+	}
+
+	int32_t toFixed(float value, float scale)
+	{
+		return static_cast<int32_t>(std::lround(value * scale));
+	}
+
+	uint8_t toColourByte(float component)
+	{
+		return static_cast<uint8_t>(std::lround(std::clamp(component, 0.f, 1.f) * 255.f));
+	}
+
+	bool isFromWebServer(uint8_t type)
+	{
+		return type == JOIN || type == TURN || type == DISABLE || type == ENABLE
+			|| type == COLOURS_REQUEST;
+	}
+
+	bool parseText(ByteSpan data, Message& message)
+	{
+		TextReader input(data);
+		std::string_view type;
+		if (!input.readWord(type) || type.size() != 1 || !isFromWebServer(static_cast<uint8_t>(type[0])))
+			return false;
+		message.mType = static_cast<MessageType>(type[0]);
+		if (!input.read(message.mId))
+			return false;
+
+		//Players who did not type a name join with an empty one
+		if (message.mType == JOIN)
+		{
+			input.readWord(message.mName);
+			return true;
+		}
+		if (message.mType == TURN)
+			return input.read(message.mTurnSpeed);
+		return true;
+	}
+
+	bool parseBinary(ByteSpan data, Message& message)
+	{
+		if (data.mSize == 0 || !isFromWebServer(static_cast<uint8_t>(data.mData[0])))
+			return false;
+		message.mType = static_cast<MessageType>(data.mData[0]);
+
+		BinaryReader input(ByteSpan(data.mData + 1, data.mSize - 1));
+		uint32_t id;
+		if (!input.readVarint(id))
+			return false;
+		message.mId = id;
+
+		if (message.mType == JOIN)
+		{
+			uint32_t nameSize;
+			return input.readVarint(nameSize) && input.readText(message.mName, nameSize);
+		}
+		if (message.mType == TURN)
+		{
+			int32_t turnSpeed;
+			if (!input.readZigzag(turnSpeed))
+				return false;
+			message.mTurnSpeed = static_cast<float>(turnSpeed) / TURN_SPEED_SCALE;
+		}
+		return true;
+	}
+} // namespace
+
+bool RelayProtocol::parse(ByteSpan data, Format format, Message& message)
+{
+	message = Message{};
+	return format == BINARY ? parseBinary(data, message) : parseText(data, message);
+}
+
+void RelayProtocol::writePoints(MessageBuffer& buffer, Format format, unsigned id, int points)
+{
+	buffer.clear();
+	if (format == BINARY)
+	{
+		appendByte(buffer, POINTS);
+		appendVarint(buffer, id);
+		appendZigzag(buffer, points);
+		return;
+	}
+	//The web server finds the points after the id and three spaces
+	buffer.append("P ");
+	buffer.appendNumber(id);
+	buffer.append("   ");
+	buffer.appendNumber(points);
+}
+
+void RelayProtocol::writeTime(MessageBuffer& buffer, Format format, float passedTime)
+{
+	buffer.clear();
+	if (format == BINARY)
+	{
+		appendByte(buffer, TIME);
+		appendVarint(buffer, static_cast<uint32_t>(std::max(toFixed(passedTime, TIME_SCALE), 0)));
+		return;
+	}
+	buffer.append("T ");
+	buffer.appendNumber(passedTime);
+}
+
+void RelayProtocol::writeGameState(MessageBuffer& buffer, Format format, bool hasEnded)
+{
+	buffer.clear();
+	if (format == BINARY)
+	{
+		appendByte(buffer, GAME_STATE);
+		appendByte(buffer, hasEnded ? 1 : 0);
+		return;
+	}
+	buffer.append(hasEnded ? "U end" : "U start");
+}
+
+void RelayProtocol::writeColour(MessageBuffer& buffer, Format format, MessageType type,
+                                unsigned id, const glm::vec3& colour)
+{
+	buffer.clear();
+	if (format == BINARY)
+	{
+		appendByte(buffer, type);
+		appendVarint(buffer, id);
+		appendByte(buffer, toColourByte(colour.r));
+		appendByte(buffer, toColourByte(colour.g));
+		appendByte(buffer, toColourByte(colour.b));
+		return;
+	}
+	//The colour is written like glm::to_string, which the web server takes apart
+	char text[96];
+	const int length = std::snprintf(text, sizeof(text), "%c vec3(%f, %f, %f) %u",
+		static_cast<char>(type), colour.r, colour.g, colour.b, id);
+	buffer.append(text, length > 0 ? static_cast<size_t>(length) : 0);
+}
+
+void RelayProtocol::writeJoin(MessageBuffer& buffer, unsigned id, std::string_view name)
+{
+	buffer.clear();
+	appendByte(buffer, JOIN);
+	appendVarint(buffer, id);
+	appendVarint(buffer, static_cast<uint32_t>(name.size()));
+	buffer.append(name);
+}
+
+void RelayProtocol::writeTurn(MessageBuffer& buffer, unsigned id, float turnSpeed)
+{
+	buffer.clear();
+	appendByte(buffer, TURN);
+	appendVarint(buffer, id);
+	appendZigzag(buffer, toFixed(turnSpeed, TURN_SPEED_SCALE));
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "glm/vec3.hpp"
+
+#include "bytestream.hpp"
+#include "messagebuffer.hpp"
+
+//Messages between the game and the web server that relays the phones
+//The game offers both WebSocket protocols and the web server picks one:
+//  TEXT_NAME    The original text messages, e.g. "C 3 0.25"
+//  BINARY_NAME  Type byte followed by little-endian base 128 varints. IDs are plain
+//               varints, signed values are zigzag encoded varints. Fixed-point values:
+//               turn speed in 1/1024 radians per second, passed time in 1/1000 of
+//               the round and colour components as one byte each
+//Type bytes are the letters of the text format. 0 is never a type, so a binary frame
+//that starts with 0 is a batch (see WebSocketHandler)
+//
+//Message layouts in the binary format:
+//  JOIN             varint id, varint name length, name
+//  TURN             varint id, zigzag turn speed
+//  DISABLE, ENABLE, COLOURS_REQUEST  varint id
+//  POINTS           varint id, zigzag points
+//  TIME             varint passed time
+//  GAME_STATE       uint8 0 when the game starts, 1 when it ends
+//  COLOUR_ONE, COLOUR_TWO  varint id, uint8 red, green, blue
+namespace RelayProtocol {
+	constexpr const char* TEXT_NAME = "example-protocol";
+	constexpr const char* BINARY_NAME = "domedagen-binary-1";
+
+	//Fixed-point scales of turn speeds and passed time in the binary format
+	constexpr float TURN_SPEED_SCALE = 1024.f;
+	constexpr float TIME_SCALE = 1000.f;
+
+	enum Format : uint8_t
+	{
+		TEXT = 0,
+		BINARY = 1
+	};
+
+	enum MessageType : uint8_t
+	{
+		//Web server to game
+		JOIN = 'N',
+		TURN = 'C',
+		DISABLE = 'D',
+		ENABLE = 'E',
+		COLOURS_REQUEST = 'I',
+
+		//Game to web server
+		POINTS = 'P',
+		TIME = 'T',
+		GAME_STATE = 'U',
+		COLOUR_ONE = 'A',
+		COLOUR_TWO = 'B'
+	};
+
+	//Message from the web server, parsed in place
+	struct Message
+	{
+		MessageType mType;
+		unsigned mId = 0;
+
+		//Only set for TURN
+		float mTurnSpeed = 0.f;
+
+		//Only set for JOIN, points into the parsed data
+		std::string_view mName;
+	};
+
+	//False if data is not a complete message from the web server in format
+	bool parse(ByteSpan data, Format format, Message& message);
+
+	//Replace the contents of buffer with a message to the web server
+	void writePoints(MessageBuffer& buffer, Format format, unsigned id, int points);
+	//passedTime is the part of the round that has passed, in [0, 1]
+	void writeTime(MessageBuffer& buffer, Format format, float passedTime);
+	void writeGameState(MessageBuffer& buffer, Format format, bool hasEnded);
+	//type is COLOUR_ONE or COLOUR_TWO, components are in [0, 1]
+	void writeColour(MessageBuffer& buffer, Format format, MessageType type, unsigned id,
+	                 const glm::vec3& colour);
+
+	//Message to the game in the binary format, for tools that script input
+	void writeJoin(MessageBuffer& buffer, unsigned id, std::string_view name);
+	void writeTurn(MessageBuffer& buffer, unsigned id, float turnSpeed);
+} // namespace RelayProtocol
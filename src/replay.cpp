@@ -0,0 +1,273 @@
+//
+//  Headless playback of a sync recording (recordFile in config.ini)
+//  Decodes the recorded frames like a render node does, or feeds the recorded
+//  websocket messages into a master simulation, as fast as possible
+//
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "simulation.hpp"
+#include "simlog.hpp"
+#include "syncstream.hpp"
+#include "syncstats.hpp"
+#include "synclog.hpp"
+#include "relayprotocol.hpp"
+
+namespace {
+	struct ReplayConfig
+	{
+		std::string logPath;
+
+		//Run a master simulation from the messages instead of decoding the frames
+		bool simulate = false;
+		unsigned repeat = 1;
+		bool verbose = false;
+		std::string csvPath;
+
+		//Only used when simulating, should match [Game] in config.ini of the show
+		unsigned maxPlayers = 110;
+		unsigned maxCollectibles = 300;
+		float tickRate = 60.f;
+		float maxTime = 120.f;
+		//The seed recorded in the log unless one is given
+		unsigned seed = 1;
+		bool hasSeed = false;
+
+		//Encoder settings with --simulate, see [Sync] in config.ini
+		unsigned keyframeInterval = 60;
+		unsigned playerSyncInterval = 4;
+		bool collectibleEvents = true;
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	struct ReplayResult
+	{
+		unsigned mNumFrames = 0;
+		unsigned mNumMessages = 0;
+		unsigned mNumSkipped = 0;
+		double mRecordedSeconds = 0.0;
+		Clock::duration mWallTime{ 0 };
+	};
+
+	void printUsage()
+	{
+		std::printf(
+			"Usage: domedagen_replay LOG [options]\n"
+			"  --simulate        run master from the recorded messages instead of decoding frames\n"
+			"  --repeat N        play the log N times (default 1)\n"
+			"  --csv FILE        write the size and encode/decode times of every frame to FILE\n"
+			"  --players N       players the simulation is sized for (default 110)\n"
+			"  --collectibles M  collectibles the simulation is sized for (default 300)\n"
+			"  --tickrate R      simulation steps per second with --simulate (default 60)\n"
+			"  --max-time T      round length in seconds with --simulate (default 120)\n"
+			"  --seed S          seed for spawn positions with --simulate (default the\n"
+			"                    seed master recorded, 1 for logs without one)\n"
+			"  --keyframe N      frames between sync keyframes with --simulate (default 60)\n"
+			"  --player-sync N   frames between player position updates with --simulate (default 4)\n"
+			"  --collect-states  sync collectible states instead of events with --simulate\n"
+			"  --verbose         print simulation log messages\n");
+	}
+
+	bool parseArguments(int argc, char** argv, ReplayConfig& config)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+
+			if (arg == "--simulate")
+				config.simulate = true;
+			else if (arg == "--repeat" && hasValue)
+				config.repeat = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--csv" && hasValue)
+				config.csvPath = argv[++i];
+			else if (arg == "--players" && hasValue)
+				config.maxPlayers = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--collectibles" && hasValue)
+				config.maxCollectibles = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--tickrate" && hasValue)
+				config.tickRate = std::stof(argv[++i]);
+			else if (arg == "--max-time" && hasValue)
+				config.maxTime = std::stof(argv[++i]);
+			else if (arg == "--seed" && hasValue)
+			{
+				config.seed = static_cast<unsigned>(std::stoul(argv[++i]));
+				config.hasSeed = true;
+			}
+			else if (arg == "--keyframe" && hasValue)
+				config.keyframeInterval = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--player-sync" && hasValue)
+				config.playerSyncInterval = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--collect-states")
+				config.collectibleEvents = false;
+			else if (arg == "--verbose")
+				config.verbose = true;
+			else if (arg[0] != '-' && config.logPath.empty())
+				config.logPath = arg;
+			else
+				return false;
+		}
+		return !config.logPath.empty() && config.repeat > 0 && config.tickRate > 0.f;
+	}
+
+	//The messages of messageReceived() in main.cpp that change the simulation
+	void applyMessage(Simulation& simulation, const SyncLog::Record& record)
+	{
+		const RelayProtocol::Format format = record.mType == SyncLog::BINARY_MESSAGE
+			? RelayProtocol::BINARY : RelayProtocol::TEXT;
+		RelayProtocol::Message message;
+		if (!RelayProtocol::parse(record.mData, format, message))
+			return;
+
+		const unsigned id = message.mId;
+		const size_t numPlayers = simulation.getPlayers().size();
+		if (message.mType == RelayProtocol::JOIN && id == numPlayers)
+			simulation.addPlayer(std::make_tuple(id, std::string(message.mName)));
+		else if (message.mType == RelayProtocol::TURN && id < numPlayers)
+			simulation.updateTurnSpeed(std::make_tuple(id, message.mTurnSpeed));
+		else if (message.mType == RelayProtocol::DISABLE && id < numPlayers)
+			simulation.disablePlayer(id);
+		else if (message.mType == RelayProtocol::ENABLE && id < numPlayers)
+			simulation.enablePlayer(id);
+	}
+
+	//Decode every frame into a simulation like decode() on a render node
+	void decodeLog(SyncLogReader& log, SyncStats& stats, const ReplayConfig& config, ReplayResult& result)
+	{
+		Simulation node;
+		node.init(config.maxPlayers, config.maxCollectibles);
+		SyncDecoder decoder;
+
+		SyncLog::Record record;
+		while (log.next(record))
+		{
+			result.mRecordedSeconds = record.mTime;
+			if (record.mType != SyncLog::FRAME)
+			{
+				++result.mNumMessages;
+				continue;
+			}
+			++result.mNumFrames;
+
+			ByteReader input(record.mData, 0);
+			GameFrameHeader header{};
+			if (!header.read(input) || header.mIsGameEnded)
+				continue;
+
+			if (header.mIsGameStarted)
+				node.setSyncedTime(header.mRenderTime);
+			size_t pos = input.getPos();
+			if (!decoder.decode(record.mData, pos, node))
+				++result.mNumSkipped;
+			stats.add(decoder.getFrameStats());
+		}
+	}
+
+	//Run master from the recorded messages, stepped by the recorded frame times
+	void simulateLog(SyncLogReader& log, SyncStats& stats, const ReplayConfig& config, ReplayResult& result)
+	{
+		Simulation simulation;
+		simulation.init(config.maxPlayers, config.maxCollectibles, config.seed);
+		simulation.setTickRate(config.tickRate, 5);
+		simulation.setMaxTime(config.maxTime);
+
+		simulation.setCollectEventLogging(config.collectibleEvents);
+
+		SyncEncoder encoder;
+		encoder.setKeyframeInterval(config.keyframeInterval);
+		encoder.setPlayerSyncInterval(config.playerSyncInterval);
+		encoder.setCollectibleEvents(config.collectibleEvents);
+		std::vector<std::byte> frame;
+		bool isStarted = false;
+		double lastFrameTime = 0.0;
+
+		SyncLog::Record record;
+		while (log.next(record))
+		{
+			result.mRecordedSeconds = record.mTime;
+			if (record.mType != SyncLog::FRAME)
+			{
+				applyMessage(simulation, record);
+				++result.mNumMessages;
+				continue;
+			}
+			++result.mNumFrames;
+
+			ByteReader input(record.mData, 0);
+			GameFrameHeader header{};
+			if (!header.read(input))
+				continue;
+
+			if (header.mIsGameStarted && !isStarted)
+			{
+				simulation.startGame();
+				isStarted = true;
+			}
+			else if (isStarted)
+				simulation.advance(static_cast<float>(record.mTime - lastFrameTime));
+			lastFrameTime = record.mTime;
+
+			frame.clear();
+			encoder.encode(simulation, frame);
+			simulation.clearCollectEvents();
+			simulation.clearIdPoints();
+			stats.add(encoder.getFrameStats());
+		}
+	}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	ReplayConfig config;
+	if (!parseArguments(argc, argv, config))
+	{
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	if (!config.verbose)
+		SimLog::setCallback(nullptr);
+
+	SyncLogReader log;
+	if (!log.open(config.logPath))
+	{
+		std::printf("could not open %s as a sync recording\n", config.logPath.c_str());
+		return EXIT_FAILURE;
+	}
+	if (!config.hasSeed && log.hasSpawnSeed())
+		config.seed = log.getSpawnSeed();
+
+	SyncStats stats(4096);
+	if (!config.csvPath.empty() && !stats.openCsv(config.csvPath))
+		std::printf("could not open %s\n", config.csvPath.c_str());
+
+	ReplayResult result;
+	const Clock::time_point start = Clock::now();
+	for (unsigned i = 0; i < config.repeat; ++i)
+	{
+		log.rewind();
+		if (config.simulate)
+			simulateLog(log, stats, config, result);
+		else
+			decodeLog(log, stats, config, result);
+	}
+	result.mWallTime = Clock::now() - start;
+
+	const double wallSeconds = std::chrono::duration<double>(result.mWallTime).count();
+	std::printf("%s, %.1f MB, %.1f recorded s, %u frames, %u messages, played %u times\n",
+		config.logPath.c_str(), log.getSize() / 1e6, result.mRecordedSeconds, result.mNumFrames / config.repeat,
+		result.mNumMessages / config.repeat, config.repeat);
+	std::printf("%s in %.3f s, %.0f frames/s, %u frames skipped\n",
+		config.simulate ? "simulated and encoded" : "decoded", wallSeconds,
+		result.mNumFrames / wallSeconds, result.mNumSkipped);
+	if (config.simulate)
+		std::printf("spawn seed %u, %s\n", config.seed,
+			config.hasSeed ? "from --seed" : log.hasSpawnSeed() ? "recorded by master" : "the log has none");
+	std::printf("per frame, p95 is a power of two upper bound\n%s", stats.getSummary().c_str());
+	return EXIT_SUCCESS;
+}
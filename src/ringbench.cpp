@@ -0,0 +1,436 @@
+//
+//  Microbenchmark of the outbound message queue of WebSocketHandler
+//  Compares MessageRing with the mutex guarded vector it replaced, both for draining a
+//  backlog and for producer threads pushing while one consumer drains
+//  Also compares the size and parse time of turn messages in both relay protocols, and
+//  simulates how long input waits from arrival until preSync applies it, with the
+//  websocket serviced once per frame or on a network thread
+//
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "inputqueue.hpp"
+#include "messagering.hpp"
+#include "relayprotocol.hpp"
+#include "syncstats.hpp"
+
+namespace {
+	struct RingBenchConfig
+	{
+		unsigned numProducers = 4;
+		unsigned numMessages = 200000;
+		//Erasing the front of the vector moves every message behind it, so the baseline
+		//gets quadratically slower the further the consumer falls behind
+		unsigned vectorMessages = 5000;
+		unsigned backlog = 20000;
+		unsigned numSlots = 4096;
+
+		//Input latency simulation, 0 seconds skips it
+		float latencySeconds = 3.f;
+		float inputRate = 2200.f;
+		float frameMs = 16.7f;
+		unsigned slowEvery = 30;
+		float slowMs = 100.f;
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	//What WebSocketHandler used before, the consumer copies the front message out
+	//and erases it, which moves every message behind it
+	class VectorQueue
+	{
+	public:
+		bool push(const void* data, size_t size)
+		{
+			const std::byte* bytes = static_cast<const std::byte*>(data);
+			std::lock_guard lock(mMutex);
+			mMessages.emplace_back(bytes, bytes + size);
+			return true;
+		}
+
+		bool popInto(std::vector<std::byte>& message)
+		{
+			std::lock_guard lock(mMutex);
+			if (mMessages.empty())
+				return false;
+			message = mMessages.front();
+			mMessages.erase(mMessages.begin());
+			return true;
+		}
+
+	private:
+		std::mutex mMutex;
+		std::vector<std::vector<std::byte>> mMessages;
+	};
+
+	//Same interface as VectorQueue, the message is read in place before the slot is freed
+	class RingQueue
+	{
+	public:
+		RingQueue(size_t numSlots) : mRing(numSlots, 64) {}
+
+		bool push(const void* data, size_t size) { return mRing.push(data, size); }
+
+		bool popInto(std::vector<std::byte>& message)
+		{
+			const MessageBuffer* front = mRing.front();
+			if (!front)
+				return false;
+			message.assign(front->getData(), front->getData() + front->getSize());
+			mRing.pop();
+			return true;
+		}
+
+	private:
+		MessageRing mRing;
+	};
+
+	void printUsage()
+	{
+		std::printf(
+			"Usage: domedagen_ringbench [options]\n"
+			"  --producers P  threads queueing messages (default 4)\n"
+			"  --messages N   messages queued by each producer (default 200000)\n"
+			"  --vector-messages N  same for the mutex vector baseline (default 5000)\n"
+			"  --backlog B    messages queued before draining starts (default 20000)\n"
+			"  --slots S      slots in the ring (default 4096)\n"
+			"Input latency simulation:\n"
+			"  --latency-seconds S  length of each run, 0 skips it (default 3)\n"
+			"  --input-rate R       turn messages per second from the server (default 2200)\n"
+			"  --frame-ms F         frame time (default 16.7)\n"
+			"  --slow-every N       every Nth frame is slow, 0 for none (default 30)\n"
+			"  --slow-ms F          frame time of slow frames (default 100)\n");
+	}
+
+	bool parseArguments(int argc, char** argv, RingBenchConfig& config)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+
+			if (arg == "--producers" && hasValue)
+				config.numProducers = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--messages" && hasValue)
+				config.numMessages = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--vector-messages" && hasValue)
+				config.vectorMessages = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--backlog" && hasValue)
+				config.backlog = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--slots" && hasValue)
+				config.numSlots = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--latency-seconds" && hasValue)
+				config.latencySeconds = std::stof(argv[++i]);
+			else if (arg == "--input-rate" && hasValue)
+				config.inputRate = std::stof(argv[++i]);
+			else if (arg == "--frame-ms" && hasValue)
+				config.frameMs = std::stof(argv[++i]);
+			else if (arg == "--slow-every" && hasValue)
+				config.slowEvery = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--slow-ms" && hasValue)
+				config.slowMs = std::stof(argv[++i]);
+			else
+				return false;
+		}
+		return config.numProducers > 0 && config.numMessages > 0 && config.vectorMessages > 0
+			&& config.numSlots > 0
+			&& config.inputRate > 0.f && config.frameMs > 0.f;
+	}
+
+	//Score update like the ones Game sends, about as long
+	int formatMessage(char* buffer, size_t size, unsigned producer, unsigned index)
+	{
+		return std::snprintf(buffer, size, "P %u   %u", producer * 1000 + index % 1000, index);
+	}
+
+	double seconds(Clock::duration duration)
+	{
+		return std::chrono::duration<double>(duration).count();
+	}
+
+	//Queue backlog messages on one thread, then drain them all
+	template<typename Queue>
+	double drainBacklog(Queue& queue, unsigned backlog)
+	{
+		char text[32];
+		for (unsigned i = 0; i < backlog; ++i)
+			queue.push(text, static_cast<size_t>(formatMessage(text, sizeof(text), 0, i)));
+
+		std::vector<std::byte> message;
+		const Clock::time_point start = Clock::now();
+		unsigned drained = 0;
+		while (queue.popInto(message))
+			++drained;
+		return drained / seconds(Clock::now() - start);
+	}
+
+	//Parse numMessages turn messages like the ones the phones send most, in format
+	//Returns messages per second, bytes is set to the mean message size
+	double parseTurns(RelayProtocol::Format format, unsigned numMessages, double& bytes)
+	{
+		//A spread of players and turn speeds, written up front
+		constexpr unsigned NumDistinct = 1024;
+		std::vector<MessageBuffer> messages(NumDistinct);
+		size_t totalBytes = 0;
+		for (unsigned i = 0; i < NumDistinct; ++i)
+		{
+			const unsigned id = i % 110;
+			const float turnSpeed = static_cast<float>(i % 200) / 100.f - 1.f;
+			if (format == RelayProtocol::BINARY)
+				RelayProtocol::writeTurn(messages[i], id, turnSpeed);
+			else
+			{
+				char text[32];
+				const int length = std::snprintf(text, sizeof(text), "C %u %f", id, turnSpeed);
+				messages[i].append(text, static_cast<size_t>(length));
+			}
+			totalBytes += messages[i].getSize();
+		}
+		bytes = static_cast<double>(totalBytes) / NumDistinct;
+
+		RelayProtocol::Message message;
+		float checksum = 0.f;
+		const Clock::time_point start = Clock::now();
+		for (unsigned i = 0; i < numMessages; ++i)
+		{
+			if (RelayProtocol::parse(messages[i % NumDistinct].getBytes(), format, message))
+				checksum += message.mTurnSpeed;
+		}
+		const double elapsed = seconds(Clock::now() - start);
+		if (checksum == 12345.f)
+			std::printf(" ");
+		return numMessages / elapsed;
+	}
+
+	//A server thread sends turn messages at inputRate into a stand-in for the socket, and
+	//a render loop applies them once per frame, with a slow frame every slowEvery frames
+	//Without a network thread the render loop services the socket at the start of each
+	//frame and, like lws_service, reads at most one receive buffer of 1024 bytes
+	//With one, a network thread parses every message as it arrives and pushes it into an
+	//InputQueue that the render loop drains
+	//Returns microseconds from arrival until the message was applied
+	RollingHistogram inputLatency(const RingBenchConfig& config, bool hasNetworkThread)
+	{
+		constexpr size_t ReceiveBufferBytes = 1024;
+		const size_t maxMessages = static_cast<size_t>(config.inputRate * config.latencySeconds) + 1;
+		RollingHistogram latency(maxMessages);
+
+		//Messages start with the time they were sent, followed by the turn message
+		MessageRing socket(65536, 64);
+		InputQueue inputQueue(65536);
+		std::atomic<bool> isSending{ true };
+		std::atomic<bool> isReceiving{ true };
+		const Clock::time_point start = Clock::now();
+		auto now = [start]() { return seconds(Clock::now() - start); };
+
+		std::thread server([&]()
+		{
+			MessageBuffer turn;
+			for (size_t i = 0; i < maxMessages; ++i)
+			{
+				std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+					std::chrono::duration<double>(i / config.inputRate)));
+				RelayProtocol::writeTurn(turn, static_cast<unsigned>(i % 110), 0.5f);
+				if (MessageBuffer* message = socket.claim())
+				{
+					const double sendTime = now();
+					message->append(&sendTime, sizeof(sendTime));
+					message->append(turn.getData(), turn.getSize());
+					socket.commit(message);
+				}
+			}
+			isSending = false;
+		});
+
+		std::thread network;
+		if (hasNetworkThread)
+		{
+			network = std::thread([&]()
+			{
+				while (isReceiving)
+				{
+					const MessageBuffer* message = socket.front();
+					if (!message)
+					{
+						std::this_thread::yield();
+						continue;
+					}
+					double sendTime;
+					std::memcpy(&sendTime, message->getData(), sizeof(sendTime));
+					inputQueue.push(ByteSpan(message->getData() + sizeof(sendTime), message->getSize() - sizeof(sendTime)),
+						RelayProtocol::BINARY, sendTime);
+					socket.pop();
+				}
+			});
+		}
+
+		//Render loop, applying a message only reads it like preSync would
+		float turnSpeeds = 0.f;
+		for (unsigned frame = 0; isSending || (hasNetworkThread ? inputQueue.front() != nullptr : !socket.empty()); ++frame)
+		{
+			const double frameStart = now();
+			if (hasNetworkThread)
+			{
+				while (const InputEvent* event = inputQueue.front())
+				{
+					turnSpeeds += event->mMessage.mTurnSpeed;
+					latency.add((frameStart - event->mArrivalTime) * 1e6);
+					inputQueue.pop();
+				}
+			}
+			else
+			{
+				size_t received = 0;
+				const MessageBuffer* message;
+				while ((message = socket.front()) && received + message->getSize() - sizeof(double) <= ReceiveBufferBytes)
+				{
+					double sendTime;
+					std::memcpy(&sendTime, message->getData(), sizeof(sendTime));
+					RelayProtocol::Message turn;
+					if (RelayProtocol::parse(ByteSpan(message->getData() + sizeof(sendTime), message->getSize() - sizeof(sendTime)),
+						RelayProtocol::BINARY, turn))
+					{
+						turnSpeeds += turn.mTurnSpeed;
+						latency.add((frameStart - sendTime) * 1e6);
+					}
+					received += message->getSize() - sizeof(double);
+					socket.pop();
+				}
+			}
+
+			const bool isSlow = config.slowEvery > 0 && frame % config.slowEvery == config.slowEvery - 1;
+			const float frameMs = isSlow ? config.slowMs : config.frameMs;
+			std::this_thread::sleep_until(Clock::now() + std::chrono::duration_cast<Clock::duration>(
+				std::chrono::duration<float, std::milli>(frameMs)));
+		}
+
+		isReceiving = false;
+		server.join();
+		if (network.joinable())
+			network.join();
+		if (turnSpeeds < 0.f)
+			std::printf(" ");
+		return latency;
+	}
+
+	void printLatency(const char* name, const RollingHistogram& latency)
+	{
+		std::printf("%s", formatHistogram(name, latency).c_str());
+		const std::array<unsigned, RollingHistogram::NUMBUCKETS>& buckets = latency.getBuckets();
+		for (size_t i = 0; i < buckets.size(); ++i)
+		{
+			if (buckets[i] == 0)
+				continue;
+			const unsigned bar = static_cast<unsigned>(50.0 * buckets[i] / latency.getNumSamples() + 0.5);
+			std::printf("  < %9.0f us %8u %s\n", std::ldexp(1.0, static_cast<int>(i)), buckets[i],
+				std::string(bar, '#').c_str());
+		}
+		std::fflush(stdout);
+	}
+
+	//Producers push numMessages each while one consumer pops until all have arrived
+	//Producers retry when the queue is full, returns messages per second through the queue
+	template<typename Queue>
+	double throughput(Queue& queue, unsigned numProducers, unsigned numMessages, unsigned long long& numFull)
+	{
+		std::atomic<bool> go{ false };
+		std::atomic<unsigned long long> fullCount{ 0 };
+		std::vector<std::thread> producers;
+		for (unsigned p = 0; p < numProducers; ++p)
+		{
+			producers.emplace_back([&, p]()
+			{
+				while (!go.load(std::memory_order_acquire))
+					std::this_thread::yield();
+
+				char text[32];
+				for (unsigned i = 0; i < numMessages; ++i)
+				{
+					const int length = formatMessage(text, sizeof(text), p, i);
+					while (!queue.push(text, static_cast<size_t>(length)))
+					{
+						++fullCount;
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+
+		const unsigned long long total = static_cast<unsigned long long>(numProducers) * numMessages;
+		std::vector<std::byte> message;
+		const Clock::time_point start = Clock::now();
+		go.store(true, std::memory_order_release);
+		for (unsigned long long received = 0; received < total;)
+		{
+			if (queue.popInto(message))
+				++received;
+		}
+		const double elapsed = seconds(Clock::now() - start);
+
+		for (std::thread& producer : producers)
+			producer.join();
+		numFull = fullCount;
+		return total / elapsed;
+	}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	RingBenchConfig config;
+	if (!parseArguments(argc, argv, config))
+	{
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	std::printf("%u producers, %u messages each (%u for the mutex vector), backlog %u, %u ring slots\n",
+		config.numProducers, config.numMessages, config.vectorMessages, config.backlog, config.numSlots);
+	std::printf("%-14s %16s %16s %14s\n", "queue", "backlog msg/s", "concurrent msg/s", "full retries");
+	//The runs take a while, show each result as soon as it is there
+	std::fflush(stdout);
+
+	{
+		VectorQueue queue;
+		const double backlogRate = drainBacklog(queue, config.backlog);
+		unsigned long long numFull = 0;
+		const double rate = throughput(queue, config.numProducers, config.vectorMessages, numFull);
+		std::printf("%-14s %16.0f %16.0f %14llu\n", "mutex vector", backlogRate, rate, numFull);
+		std::fflush(stdout);
+	}
+	{
+		//The backlog has to fit in the ring
+		RingQueue backlogQueue(config.backlog);
+		const double backlogRate = drainBacklog(backlogQueue, config.backlog);
+		RingQueue queue(config.numSlots);
+		unsigned long long numFull = 0;
+		const double rate = throughput(queue, config.numProducers, config.numMessages, numFull);
+		std::printf("%-14s %16.0f %16.0f %14llu\n", "message ring", backlogRate, rate, numFull);
+		std::fflush(stdout);
+	}
+
+	std::printf("\n%-14s %16s %16s\n", "protocol", "turn msg/s", "bytes per msg");
+	for (RelayProtocol::Format format : { RelayProtocol::TEXT, RelayProtocol::BINARY })
+	{
+		double bytes = 0.0;
+		const double rate = parseTurns(format, config.numMessages, bytes);
+		std::printf("%-14s %16.0f %16.1f\n", format == RelayProtocol::BINARY ? "binary" : "text", rate, bytes);
+	}
+
+	if (config.latencySeconds > 0.f)
+	{
+		std::printf("\ninput latency, %.0f messages/s, %.1f ms frames, every %u %.0f ms\n",
+			config.inputRate, config.frameMs, config.slowEvery, config.slowMs);
+		printLatency("serviced per frame", inputLatency(config, false));
+		printLatency("network thread", inputLatency(config, true));
+	}
+	return EXIT_SUCCESS;
+}
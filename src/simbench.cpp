@@ -0,0 +1,780 @@
+//
+//  Headless benchmark of the game simulation
+//  Runs N players and M collectibles for T simulated seconds with scripted input
+//  and reports ticks per second and the time spent in each simulation phase
+//
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "simulation.hpp"
+#include "simlog.hpp"
+#include "conetest.hpp"
+#include "threadpool.hpp"
+#include "syncstream.hpp"
+#include "synclog.hpp"
+
+namespace {
+	//Heap allocations made by any thread, counted by the operator new below
+	std::atomic<unsigned long long> numAllocations{ 0 };
+} // namespace
+
+void* operator new(std::size_t size)
+{
+	++numAllocations;
+	if (void* memory = std::malloc(size > 0 ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+namespace {
+	struct BenchConfig
+	{
+		unsigned numPlayers = 110;
+		unsigned numCollectibles = 300;
+		float seconds = 60.f;
+		float tickRate = 60.f;
+		unsigned seed = 1;
+		unsigned numWorkers = 0;
+		bool scaling = false;
+		bool verbose = false;
+
+		//Compare the cone test with the Euler-angle test it replaced instead of simulating
+		bool narrowPhase = false;
+
+		//Encode and decode the state every tick and report sync frame sizes
+		bool sync = false;
+		unsigned keyframeInterval = 60;
+		unsigned playerSyncInterval = 1;
+		bool collectibleEvents = false;
+
+		//Log the size and times of every frame here, none if empty
+		std::string syncCsv;
+
+		//Record the frames and the scripted input as master would, none if empty
+		std::string recordPath;
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	enum Phase { INPUT, EVENTS, PLAYERS, COLLISIONS, SYNC, NUMPHASES };
+	const char* phaseNames[NUMPHASES] = { "input", "events", "players", "collisions", "sync" };
+
+	struct BenchResult
+	{
+		//Accumulated wall time of each simulation phase
+		std::array<Clock::duration, NUMPHASES> mPhases{};
+		Clock::duration mTotal{ 0 };
+		unsigned mNumTicks = 0;
+		long long mTotalPoints = 0;
+
+		//Hash of the final simulation state, equal for equal results
+		uint64_t mChecksum = 0;
+
+		//Sync bytes summed over all ticks, only with --sync
+		//Full is every object every frame, as sent before delta frames
+		unsigned long long mFullSyncBytes = 0;
+		unsigned long long mSyncBytes = 0;
+		unsigned long long mKeyframeBytes = 0;
+		unsigned mNumKeyframes = 0;
+
+		unsigned long long mKeyframeObjects = 0;
+
+		//Ticks where the decoded state did not match the encoded one
+		unsigned mSyncMismatches = 0;
+
+		//Heap allocations in encode and decode once the first simulated second is over,
+		//by then buffers and pools have grown to their working size
+		unsigned long long mEncodeAllocations = 0;
+		unsigned long long mDecodeAllocations = 0;
+		unsigned mNumSteadyTicks = 0;
+
+		//Largest difference between sent and decoded state in radians
+		float mMaxPositionError = 0.f;
+		float mMaxOrientationError = 0.f;
+
+		//Error of rendered player positions on the node, includes extrapolation
+		double mPlayerErrorSum = 0.0;
+		unsigned long long mNumPlayerSamples = 0;
+
+		//SyncStats::getSummary() over every frame of the run
+		std::string mSyncSummary;
+	};
+
+	void printUsage()
+	{
+		std::printf(
+			"Usage: domedagen_simbench [options]\n"
+			"  --players N       number of players (default 110)\n"
+			"  --collectibles M  collectibles kept enabled (default 300)\n"
+			"  --seconds T       simulated time in seconds (default 60)\n"
+			"  --tickrate R      simulation steps per second (default 60)\n"
+			"  --seed S          seed for spawn positions (default 1)\n"
+			"  --threads W       worker threads besides the main thread (default 0)\n"
+			"  --scaling         run with 0 up to all hardware threads and compare\n"
+			"  --narrow-phase    check the cone test against the old Euler-angle test and\n"
+			"                    time both, on N random sets of M candidates\n"
+			"  --sync            encode and decode the state every tick, report frame sizes\n"
+			"  --keyframe N      frames between sync keyframes (default 60)\n"
+			"  --player-sync N   frames between player position updates (default 1)\n"
+			"  --collect-events  sync collectible spawns and collects instead of collectibles\n"
+			"  --sync-csv FILE   write the size and encode/decode times of every frame to FILE\n"
+			"  --record FILE     record frames and input for domedagen_replay, needs --sync\n"
+			"  --verbose         print simulation log messages\n");
+	}
+
+	bool parseArguments(int argc, char** argv, BenchConfig& config)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+
+			if (arg == "--players" && hasValue)
+				config.numPlayers = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--collectibles" && hasValue)
+				config.numCollectibles = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--seconds" && hasValue)
+				config.seconds = std::stof(argv[++i]);
+			else if (arg == "--tickrate" && hasValue)
+				config.tickRate = std::stof(argv[++i]);
+			else if (arg == "--seed" && hasValue)
+				config.seed = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--threads" && hasValue)
+				config.numWorkers = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--scaling")
+				config.scaling = true;
+			else if (arg == "--narrow-phase")
+				config.narrowPhase = true;
+			else if (arg == "--sync")
+				config.sync = true;
+			else if (arg == "--keyframe" && hasValue)
+				config.keyframeInterval = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--player-sync" && hasValue)
+				config.playerSyncInterval = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--collect-events")
+				config.collectibleEvents = true;
+			else if (arg == "--sync-csv" && hasValue)
+				config.syncCsv = argv[++i];
+			else if (arg == "--record" && hasValue)
+				config.recordPath = argv[++i];
+			else if (arg == "--verbose")
+				config.verbose = true;
+			else
+				return false;
+		}
+		return config.tickRate > 0.f && config.seconds > 0.f;
+	}
+
+	//Scripted steering, every player weaves with its own frequency and phase
+	float scriptedTurnSpeed(unsigned player, float time)
+	{
+		const float frequency = 0.2f + 0.05f * (player % 7);
+		return 1.5f * std::sin(frequency * time + 0.7f * player);
+	}
+
+	double toMicroseconds(Clock::duration duration)
+	{
+		return std::chrono::duration<double, std::micro>(duration).count();
+	}
+
+	Clock::duration fromMicroseconds(float micros)
+	{
+		return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::micro>(micros));
+	}
+
+	//FNV-1a over the raw bytes of value
+	template<typename T>
+	void hashBytes(uint64_t& hash, const T& value)
+	{
+		unsigned char bytes[sizeof(T)];
+		std::memcpy(bytes, &value, sizeof(T));
+		for (unsigned char byte : bytes)
+		{
+			hash ^= byte;
+			hash *= 1099511628211ull;
+		}
+	}
+
+	uint64_t stateChecksum(const Simulation& simulation)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (const Player& player : simulation.getPlayers())
+		{
+			hashBytes(hash, player.getPosition());
+			hashBytes(hash, player.getOrientation());
+			hashBytes(hash, player.getPoints());
+		}
+
+		const CollectiblePool& pool = simulation.getCollectPool();
+		for (size_t i = 0; i < pool.getNumEnabled(); ++i)
+		{
+			hashBytes(hash, pool.getPosition(i));
+			hashBytes(hash, pool.getCollectibleData(i));
+		}
+		return hash;
+	}
+
+	//Angle of the rotation between a and b
+	//Uses atan2 of the rotation a * inverse(b), acos of the dot product is too coarse near 0
+	float quatError(const glm::quat& a, const glm::quat& b)
+	{
+		const glm::quat d = a * glm::conjugate(b);
+		const double vectorLength = std::sqrt(double(d.x) * d.x + double(d.y) * d.y + double(d.z) * d.z);
+		return static_cast<float>(2.0 * std::atan2(vectorLength, std::abs(double(d.w))));
+	}
+
+	//Difference of two angles, wrapped to [0, pi]
+	float angleError(float a, float b)
+	{
+		return std::abs(std::remainder(a - b, glm::two_pi<float>()));
+	}
+
+	//Compare the state a render node decoded with master, positions are allowed to be
+	//off by the packing precision which is tracked in result
+	bool checkSyncState(const Simulation& master, const Simulation& node, BenchResult& result)
+	{
+		const std::vector<Player>& sentPlayers = master.getPlayers();
+		const std::vector<Player>& players = node.getPlayers();
+		const CollectiblePool& sentPool = master.getCollectPool();
+		const CollectiblePool& pool = node.getCollectPool();
+		if (sentPlayers.size() != players.size() || sentPool.getNumEnabled() != pool.getNumEnabled())
+			return false;
+
+		auto comparePositions = [&result](const PositionData& a, const PositionData& b)
+		{
+			result.mMaxPositionError = std::max(result.mMaxPositionError,
+				quatError(glm::quat(a.mW, a.mX, a.mY, a.mZ), glm::quat(b.mW, b.mX, b.mY, b.mZ)));
+			result.mMaxOrientationError = std::max(result.mMaxOrientationError,
+				angleError(a.mOrientation, b.mOrientation));
+			return a.mRadius == b.mRadius && a.mScale == b.mScale;
+		};
+
+		//Compare what the node renders, extrapolated and faded towards the synced state,
+		//with what master renders
+		for (size_t i = 0; i < players.size(); ++i)
+		{
+			const PositionData a = sentPlayers[i].getInterpolatedPositionData(master.getRenderAlpha());
+			const PositionData b = players[i].getInterpolatedPositionData(node.getRenderAlpha());
+			if (sentPlayers[i].getPoints() != players[i].getPoints() || !comparePositions(a, b)
+				|| sentPlayers[i].isEnabled() != players[i].isEnabled()
+				|| sentPlayers[i].getName() != players[i].getName()
+				|| sentPlayers[i].getColours() != players[i].getColours())
+				return false;
+
+			result.mPlayerErrorSum += quatError(glm::quat(a.mW, a.mX, a.mY, a.mZ), glm::quat(b.mW, b.mX, b.mY, b.mZ));
+			++result.mNumPlayerSamples;
+		}
+		for (size_t i = 0; i < pool.getNumEnabled(); ++i)
+		{
+			if (sentPool.getCollectibleData(i).mSeed != pool.getCollectibleData(i).mSeed
+				|| !comparePositions(sentPool.getPositionData(i), pool.getPositionData(i)))
+				return false;
+		}
+		return true;
+	}
+
+	//Size of the vector of every object sgct synced each frame before delta frames,
+	//every object used the same struct, players and collectibles alike
+	//PlayerData then also held what is PlayerMetadata now
+	size_t fullStateBytes(const Simulation& simulation)
+	{
+		struct FullStateObject
+		{
+			PlayerData mPlayerData;
+			PlayerMetadata mMetadata;
+			PositionData mPositionData;
+			CollectibleData mCollectData;
+			bool mIsPlayer;
+		};
+		const size_t numObjects = simulation.getPlayers().size() + simulation.getCollectPool().getNumEnabled();
+		return sizeof(uint32_t) + numObjects * sizeof(FullStateObject);
+	}
+
+	//Round trip random rotations and angles through the packed format
+	//Fails if the error is larger than the packing precision allows
+	bool checkQuantization()
+	{
+		std::mt19937 gen(1);
+		std::normal_distribution<float> normal;
+		std::uniform_real_distribution<float> angles(-100.f, 100.f);
+
+		float maxPositionError = 0.f, maxOrientationError = 0.f;
+		for (unsigned i = 0; i < 100000; ++i)
+		{
+			const glm::quat q = glm::normalize(glm::quat(normal(gen), normal(gen), normal(gen), normal(gen)));
+			maxPositionError = std::max(maxPositionError,
+				quatError(q, SyncStream::unpackQuat(SyncStream::packQuat(q))));
+
+			const float angle = angles(gen);
+			maxOrientationError = std::max(maxOrientationError,
+				angleError(angle, SyncStream::unpackAngle(SyncStream::packAngle(angle))));
+		}
+
+		//Each of the three packed components is off by at most half a step, the left out
+		//one is at least 1/2 so its error is at most sqrt(3) times theirs
+		const float halfStep = 0.7072f / ((1u << SyncStream::QUATBITS) - 1);
+		const float positionBound = 2.f * 2.f * std::sqrt(3.f) * halfStep;
+		const float orientationBound = glm::pi<float>() / 65536.f + 1e-5f;
+		const bool ok = maxPositionError <= positionBound && maxOrientationError <= orientationBound;
+
+		std::printf("packing round trip, 100000 samples\n");
+		std::printf("  position      %10.2e rad max error (bound %.2e), %u bits/component, %zu bytes\n",
+			maxPositionError, positionBound, SyncStream::QUATBITS, SyncStream::PACKEDQUATBYTES);
+		std::printf("  orientation   %10.2e rad max error (bound %.2e), 2 bytes\n",
+			maxOrientationError, orientationBound);
+		return ok;
+	}
+
+	//Narrow phase before ConeTest: the roll and pitch of the rotation from player to
+	//collectible, as Euler angles, both had to be within the collision angle
+	bool eulerHit(const glm::quat& player, const glm::quat& collectible, float angle, float& roll, float& pitch)
+	{
+		const glm::quat delta = glm::normalize(glm::inverse(player) * collectible);
+		roll = std::atan2(2.f * (delta.w * delta.x + delta.y * delta.z),
+		                  1.f - 2.f * (delta.x * delta.x + delta.y * delta.y));
+		pitch = std::asin(std::clamp(2.f * (delta.w * delta.y - delta.z * delta.x), -1.f, 1.f));
+		return std::abs(roll) <= angle && std::abs(pitch) <= angle;
+	}
+
+	//Run the Euler-angle test and every compiled path of ConeTest on the same random sets
+	//The directions are the rotated -z axis, so the angle between them has
+	//cos = cos(roll) * cos(pitch) and the cone is the circle inscribed in the old square
+	//window. Hits must agree with it except in a thin band at the edge of the cone, where
+	//float rounding decides
+	bool checkNarrowPhase(const BenchConfig& config)
+	{
+		const unsigned numSets = std::max(config.numPlayers, 1u);
+		const unsigned numCandidates = std::max(config.numCollectibles, 1u);
+		const float angle = Simulation::getCollisionAngle();
+		const float cosAngle = std::cos(angle);
+		constexpr double band = 1e-5;
+
+		//Half of the candidates around the player, reaching past the corners of the
+		//square window, the other half anywhere
+		std::mt19937 gen(config.seed);
+		std::normal_distribution<float> normal;
+		std::uniform_real_distribution<float> near(-2.f * angle, 2.f * angle);
+		std::uniform_real_distribution<float> spin(-glm::pi<float>(), glm::pi<float>());
+		auto randomQuat = [&]() { return glm::normalize(glm::quat(normal(gen), normal(gen), normal(gen), normal(gen))); };
+
+		std::vector<glm::quat> players(numSets);
+		std::vector<glm::quat> candidates(size_t(numSets) * numCandidates);
+		std::vector<float> xs(candidates.size()), ys(candidates.size()), zs(candidates.size());
+		for (unsigned set = 0; set < numSets; ++set)
+		{
+			players[set] = randomQuat();
+			for (unsigned i = 0; i < numCandidates; ++i)
+			{
+				const size_t index = size_t(set) * numCandidates + i;
+				candidates[index] = i % 2 == 0
+					? glm::normalize(players[set] * glm::quat(glm::vec3(near(gen), near(gen), spin(gen))))
+					: randomQuat();
+				const glm::vec3 direction = candidates[index] * glm::vec3(0.f, 0.f, -1.f);
+				xs[index] = direction.x;
+				ys[index] = direction.y;
+				zs[index] = direction.z;
+			}
+		}
+
+		//Old hits, and which pairs are too close to the edge of the cone to compare
+		std::vector<uint8_t> oldHits(candidates.size()), inBand(candidates.size());
+		unsigned numOldHits = 0, numCornerHits = 0, numInBand = 0, numOldMismatches = 0;
+		for (unsigned set = 0; set < numSets; ++set)
+		{
+			for (unsigned i = 0; i < numCandidates; ++i)
+			{
+				const size_t index = size_t(set) * numCandidates + i;
+				float roll, pitch;
+				oldHits[index] = eulerHit(players[set], candidates[index], angle, roll, pitch);
+				const double cosBetween = std::cos(double(roll)) * std::cos(double(pitch));
+				const double between = std::acos(std::min(cosBetween, 1.0));
+				inBand[index] = std::abs(between - angle) <= band;
+				numInBand += inBand[index];
+				numOldHits += oldHits[index];
+				if (!inBand[index] && oldHits[index] && between > angle)
+					++numCornerHits;
+				//Everything inside the cone was also inside the square
+				if (!inBand[index] && between < angle && !oldHits[index])
+					++numOldMismatches;
+			}
+		}
+
+		//Repeat until each timing is long enough to trust
+		const unsigned numRepeats = std::max(1u, 2000000u / static_cast<unsigned>(candidates.size()));
+		const double numTimed = double(numRepeats) * candidates.size();
+
+		std::printf("narrow phase, %u sets of %u candidates, cone %.3f rad, %u pairs within %.0e rad of its edge\n",
+			numSets, numCandidates, angle, numInBand, band);
+		std::printf("%-14s %14s %10s %12s\n", "test", "ns/candidate", "hits", "mismatches");
+
+		unsigned numChecked = 0;
+		const Clock::time_point eulerStart = Clock::now();
+		for (unsigned repeat = 0; repeat < numRepeats; ++repeat)
+		{
+			for (unsigned set = 0; set < numSets; ++set)
+			{
+				for (unsigned i = 0; i < numCandidates; ++i)
+				{
+					float roll, pitch;
+					numChecked += eulerHit(players[set], candidates[size_t(set) * numCandidates + i], angle, roll, pitch);
+				}
+			}
+		}
+		const double eulerNs = 1000.0 * toMicroseconds(Clock::now() - eulerStart) / numTimed;
+		std::printf("%-14s %14.2f %10u %12u  %u only in the corners of the square window\n", "Euler angles",
+			eulerNs, numChecked / numRepeats, numOldMismatches, numCornerHits);
+
+		bool ok = numOldMismatches == 0;
+		std::vector<unsigned> hits(numCandidates);
+		for (unsigned p = 0; p < ConeTest::NUMPATHS; ++p)
+		{
+			const ConeTest::Path path = static_cast<ConeTest::Path>(p);
+			if (!ConeTest::hasPath(path))
+			{
+				std::printf("%-14s %14s\n", ConeTest::getPathName(path), "not compiled in");
+				continue;
+			}
+
+			//Outside the band, a cone hit is an old hit that is not in a corner
+			unsigned numHits = 0, numMismatches = 0;
+			for (unsigned set = 0; set < numSets; ++set)
+			{
+				const size_t first = size_t(set) * numCandidates;
+				const glm::vec3 direction = players[set] * glm::vec3(0.f, 0.f, -1.f);
+				const size_t numSetHits = ConeTest::findHits(path, &xs[first], &ys[first], &zs[first], numCandidates,
+					direction, cosAngle, hits.data());
+				numHits += static_cast<unsigned>(numSetHits);
+
+				size_t next = 0;
+				for (unsigned i = 0; i < numCandidates; ++i)
+				{
+					const bool isHit = next < numSetHits && hits[next] == i;
+					next += isHit;
+					float roll, pitch;
+					eulerHit(players[set], candidates[first + i], angle, roll, pitch);
+					const bool isInCone = std::cos(double(roll)) * std::cos(double(pitch)) >= std::cos(double(angle));
+					if (!inBand[first + i] && (isHit != isInCone || (isHit && !oldHits[first + i])))
+						++numMismatches;
+				}
+			}
+
+			const Clock::time_point start = Clock::now();
+			size_t numTimedHits = 0;
+			for (unsigned repeat = 0; repeat < numRepeats; ++repeat)
+			{
+				for (unsigned set = 0; set < numSets; ++set)
+				{
+					const size_t first = size_t(set) * numCandidates;
+					const glm::vec3 direction = players[set] * glm::vec3(0.f, 0.f, -1.f);
+					numTimedHits += ConeTest::findHits(path, &xs[first], &ys[first], &zs[first], numCandidates,
+						direction, cosAngle, hits.data());
+				}
+			}
+			const double ns = 1000.0 * toMicroseconds(Clock::now() - start) / numTimed;
+			std::printf("%-14s %14.2f %10u %12u  %.0fx faster\n", ConeTest::getPathName(path), ns,
+				static_cast<unsigned>(numTimedHits / numRepeats), numMismatches, eulerNs / ns);
+			ok = ok && numMismatches == 0;
+		}
+		return ok;
+	}
+
+	BenchResult runBenchmark(const BenchConfig& config, unsigned numWorkers)
+	{
+		Simulation simulation;
+		simulation.init(config.numPlayers, config.numCollectibles, config.seed);
+		simulation.setMaxTime(config.seconds + 1.f);
+		simulation.setTickRate(config.tickRate, 1);
+		simulation.setNumWorkers(numWorkers);
+
+		for (unsigned i = 0; i < config.numPlayers; ++i)
+			simulation.addPlayer(std::make_tuple(i, "bench" + std::to_string(i)));
+
+		//Keep the pool topped up so collision load stays at numCollectibles
+		auto refillCollectibles = [&]()
+		{
+			while (simulation.getCollectPool().getNumEnabled() < config.numCollectibles)
+				simulation.addCollectible();
+		};
+
+		//Input is recorded as the websocket messages main.cpp would have received
+		SyncRecorder recorder;
+		char message[64];
+		auto recordMessage = [&](double time, int length)
+		{
+			recorder.record(SyncLog::MESSAGE, time,
+				ByteSpan(reinterpret_cast<const std::byte*>(message), static_cast<size_t>(length)));
+		};
+		if (config.sync && !config.recordPath.empty())
+		{
+			if (!recorder.open(config.recordPath, simulation.getSpawnSeed()))
+				std::printf("could not open %s\n", config.recordPath.c_str());
+			for (unsigned i = 0; i < config.numPlayers; ++i)
+				recordMessage(0.0, std::snprintf(message, sizeof(message), "N %u bench%u", i, i));
+		}
+
+		simulation.startGame();
+
+		//Render node that only follows the frames of simulation
+		Simulation node;
+		SyncEncoder syncEncoder;
+		SyncDecoder syncDecoder;
+		SyncStats syncStats(static_cast<size_t>(config.seconds * config.tickRate));
+		if (config.sync)
+		{
+			if (!config.syncCsv.empty() && !syncStats.openCsv(config.syncCsv))
+				std::printf("could not open %s\n", config.syncCsv.c_str());
+			node.init(config.numPlayers, config.numCollectibles, config.seed);
+			syncEncoder.setKeyframeInterval(config.keyframeInterval);
+			syncEncoder.setPlayerSyncInterval(config.playerSyncInterval);
+			syncEncoder.setCollectibleEvents(config.collectibleEvents);
+			simulation.setCollectEventLogging(config.collectibleEvents);
+		}
+
+		BenchResult result;
+		const float tickLength = simulation.getTickLength();
+		result.mNumTicks = static_cast<unsigned>(config.seconds * config.tickRate);
+
+		const Clock::time_point benchStart = Clock::now();
+		Clock::time_point start = benchStart;
+		auto lap = [&](Phase phase)
+		{
+			const Clock::time_point end = Clock::now();
+			result.mPhases[phase] += end - start;
+			start = end;
+		};
+
+		for (unsigned tick = 0; tick < result.mNumTicks; ++tick)
+		{
+			const float time = tick * tickLength;
+
+			for (unsigned i = 0; i < config.numPlayers; ++i)
+			{
+				const float turnSpeed = scriptedTurnSpeed(i, time);
+				simulation.updateTurnSpeed(std::make_tuple(i, turnSpeed));
+				if (recorder.isOpen())
+					recordMessage(time, std::snprintf(message, sizeof(message), "C %u %g", i, turnSpeed));
+			}
+
+			//Players drop out and come back now and then so their metadata changes
+			if (config.sync && config.numPlayers > 0 && tick % 30 == 0)
+			{
+				const unsigned id = (tick / 30) % config.numPlayers;
+				const bool isEnabled = simulation.getPlayers()[id].isEnabled();
+				if (isEnabled)
+					simulation.disablePlayer(id);
+				else
+					simulation.enablePlayer(id);
+				if (recorder.isOpen())
+					recordMessage(time, std::snprintf(message, sizeof(message), "%c %u", isEnabled ? 'D' : 'E', id));
+			}
+			refillCollectibles();
+			lap(INPUT);
+
+			//A frame of one tick, so time and the spawn schedule run as in the game
+			simulation.advance(tickLength);
+			const Simulation::TickStats& tickStats = simulation.getTickStats();
+			result.mPhases[EVENTS] += fromMicroseconds(tickStats.mEventsTime);
+			result.mPhases[PLAYERS] += fromMicroseconds(tickStats.mPlayersTime);
+			result.mPhases[COLLISIONS] += fromMicroseconds(tickStats.mCollisionsTime);
+			start = Clock::now();
+
+			if (config.sync)
+			{
+				//A new frame with the header in front, like encode() in main.cpp. Its reserve
+				//is the one allocation expected per frame, so it is not counted
+				std::vector<std::byte> frame;
+				frame.reserve(GameFrameHeader::BYTES + syncEncoder.getReserveBytes(simulation));
+				const unsigned long long allocationsBefore = numAllocations;
+				const GameFrameHeader header{ false, false, true, simulation.getRenderTime() };
+				header.write(frame);
+				syncEncoder.encode(simulation, frame);
+				simulation.clearCollectEvents();
+				const unsigned long long allocationsEncoded = numAllocations;
+				const size_t frameBytes = frame.size() - GameFrameHeader::BYTES;
+
+				//Players on the node are extrapolated to the time master renders
+				node.setSyncedTime(simulation.getRenderTime());
+
+				size_t pos = GameFrameHeader::BYTES;
+				const bool applied = syncDecoder.decode(ByteSpan(frame), pos, node);
+				const unsigned long long allocationsDecoded = numAllocations;
+
+				if (!applied || !checkSyncState(simulation, node, result))
+					++result.mSyncMismatches;
+				lap(SYNC);
+
+				if (recorder.isOpen())
+					recorder.record(SyncLog::FRAME, time + tickLength, ByteSpan(frame));
+
+				//Master and node stats of the same frame in one row
+				SyncFrameStats frameStats = syncEncoder.getFrameStats();
+				const SyncFrameStats& decodeStats = syncDecoder.getFrameStats();
+				frameStats.mDecodeTime = decodeStats.mDecodeTime;
+				frameStats.mPlayerApplyTime = decodeStats.mPlayerApplyTime;
+				frameStats.mCollectibleApplyTime = decodeStats.mCollectibleApplyTime;
+				syncStats.add(frameStats);
+
+				if (time >= 1.f)
+				{
+					result.mEncodeAllocations += allocationsEncoded - allocationsBefore;
+					result.mDecodeAllocations += allocationsDecoded - allocationsEncoded;
+					++result.mNumSteadyTicks;
+				}
+
+				result.mFullSyncBytes += fullStateBytes(simulation);
+				result.mSyncBytes += frameBytes;
+				if (syncEncoder.wasKeyframe())
+				{
+					result.mKeyframeBytes += frameBytes;
+					result.mKeyframeObjects += simulation.getPlayers().size()
+						+ simulation.getCollectPool().getNumEnabled();
+					++result.mNumKeyframes;
+				}
+			}
+
+			simulation.clearIdPoints();
+		}
+		result.mTotal = Clock::now() - benchStart;
+
+		for (const Player& player : simulation.getPlayers())
+			result.mTotalPoints += player.getPoints();
+		result.mChecksum = stateChecksum(simulation);
+		result.mSyncSummary = syncStats.getSummary();
+
+		return result;
+	}
+
+	double ticksPerSecond(const BenchResult& result)
+	{
+		return result.mNumTicks / std::chrono::duration<double>(result.mTotal).count();
+	}
+
+	void printPhases(const BenchResult& result)
+	{
+		std::printf("wall time %.3f s, %.0f ticks/s, %lld points scored, state %016llx\n",
+			std::chrono::duration<double>(result.mTotal).count(), ticksPerSecond(result),
+			result.mTotalPoints, static_cast<unsigned long long>(result.mChecksum));
+
+		std::printf("%-14s %12s %12s %8s\n", "phase", "total ms", "us/tick", "share");
+		for (unsigned phase = 0; phase < NUMPHASES; ++phase)
+		{
+			const double totalMicros = toMicroseconds(result.mPhases[phase]);
+			std::printf("%-14s %12.3f %12.3f %7.1f%%\n", phaseNames[phase], totalMicros / 1000.0,
+				totalMicros / result.mNumTicks, 100.0 * totalMicros / toMicroseconds(result.mTotal));
+		}
+	}
+
+	void printSync(const BenchResult& result, const BenchConfig& config)
+	{
+		const unsigned numDeltas = result.mNumTicks - result.mNumKeyframes;
+		std::printf("sync, keyframe every %u frames, player positions every %u frames%s\n",
+			config.keyframeInterval, config.playerSyncInterval,
+			config.collectibleEvents ? ", collectible events" : "");
+		std::printf("  full state    %10.0f bytes/frame\n", double(result.mFullSyncBytes) / result.mNumTicks);
+		std::printf("  keyframe      %10.0f bytes/frame, %.1f bytes/object\n",
+			result.mNumKeyframes ? double(result.mKeyframeBytes) / result.mNumKeyframes : 0.0,
+			result.mKeyframeObjects ? double(result.mKeyframeBytes) / result.mKeyframeObjects : 0.0);
+		std::printf("  delta         %10.0f bytes/frame\n",
+			numDeltas ? double(result.mSyncBytes - result.mKeyframeBytes) / numDeltas : 0.0);
+		std::printf("  average       %10.0f bytes/frame, %.1fx smaller than full state\n",
+			double(result.mSyncBytes) / result.mNumTicks, double(result.mFullSyncBytes) / result.mSyncBytes);
+		std::printf("  position      %10.2e rad max error\n", result.mMaxPositionError);
+		std::printf("  orientation   %10.2e rad max error\n", result.mMaxOrientationError);
+		std::printf("  players       %10.2e rad mean error as rendered\n",
+			result.mNumPlayerSamples ? result.mPlayerErrorSum / result.mNumPlayerSamples : 0.0);
+		std::printf("  mismatches    %10u\n", result.mSyncMismatches);
+		std::printf("  allocations   %10llu in encode, %llu in decode over %u steady frames\n",
+			result.mEncodeAllocations, result.mDecodeAllocations, result.mNumSteadyTicks);
+		std::printf("per frame, p95 is a power of two upper bound\n%s", result.mSyncSummary.c_str());
+	}
+
+	//Run once per worker count and report speedup of the parallel phases
+	bool printScaling(const BenchConfig& config)
+	{
+		std::vector<unsigned> workerCounts{ 0 };
+		for (unsigned workers = 1; workers < ThreadPool::hardwareWorkers(); workers *= 2)
+			workerCounts.push_back(workers);
+		if (ThreadPool::hardwareWorkers() > 0)
+			workerCounts.push_back(ThreadPool::hardwareWorkers());
+
+		std::printf("%-8s %12s %14s %14s %10s  %s\n",
+			"threads", "ticks/s", "players us", "collisions us", "speedup", "state");
+
+		bool deterministic = true;
+		BenchResult baseline;
+		for (unsigned workers : workerCounts)
+		{
+			const BenchResult result = runBenchmark(config, workers);
+			if (workers == 0)
+				baseline = result;
+
+			const double parallelMicros = toMicroseconds(result.mPhases[PLAYERS] + result.mPhases[COLLISIONS]);
+			const double baselineMicros = toMicroseconds(baseline.mPhases[PLAYERS] + baseline.mPhases[COLLISIONS]);
+			const bool sameState = result.mChecksum == baseline.mChecksum;
+			deterministic = deterministic && sameState;
+
+			std::printf("%-8u %12.0f %14.3f %14.3f %9.2fx  %016llx%s\n", workers + 1, ticksPerSecond(result),
+				toMicroseconds(result.mPhases[PLAYERS]) / result.mNumTicks,
+				toMicroseconds(result.mPhases[COLLISIONS]) / result.mNumTicks,
+				baselineMicros / parallelMicros, static_cast<unsigned long long>(result.mChecksum),
+				sameState ? "" : " MISMATCH");
+		}
+		return deterministic;
+	}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	BenchConfig config;
+	if (!parseArguments(argc, argv, config))
+	{
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	if (!config.verbose)
+		SimLog::setCallback(nullptr);
+
+	std::printf("players %u, collectibles %u, %.1f simulated s at %.0f Hz, narrow phase %s\n",
+		config.numPlayers, config.numCollectibles, config.seconds, config.tickRate,
+		ConeTest::instructionSet());
+
+	if (config.narrowPhase)
+		return checkNarrowPhase(config) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	if (config.scaling)
+		return printScaling(config) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	const BenchResult result = runBenchmark(config, config.numWorkers);
+	printPhases(result);
+	if (config.sync)
+	{
+		printSync(result, config);
+		const bool packingOk = checkQuantization();
+		const bool noAllocations = result.mEncodeAllocations == 0 && result.mDecodeAllocations == 0;
+		return result.mSyncMismatches == 0 && packingOk && noAllocations ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
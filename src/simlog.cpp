@@ -0,0 +1,22 @@
+#include "simlog.hpp"
+
+#include <iostream>
+
+namespace
+{
+	SimLog::Callback logCallback = [](const std::string& message)
+	{
+		std::cout << message << '\n';
+	};
+}
+
+void SimLog::setCallback(Callback callback)
+{
+	logCallback = std::move(callback);
+}
+
+void SimLog::info(const std::string& message)
+{
+	if (logCallback)
+		logCallback(message);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+//Logging for the simulation library, which can not depend on sgct::Log
+//Messages are printed to stdout until the application installs its own callback
+namespace SimLog
+{
+	using Callback = std::function<void(const std::string& message)>;
+
+	//Route all messages to callback, an empty callback silences the log
+	void setCallback(Callback callback);
+
+	void info(const std::string& message);
+}
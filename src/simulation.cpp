@@ -0,0 +1,418 @@
+#include "simulation.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "conetest.hpp"
+#include "simlog.hpp"
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	//Microseconds from start until now, start is moved to now
+	float lapMicroseconds(Clock::time_point& start)
+	{
+		const Clock::time_point now = Clock::now();
+		const float micros = std::chrono::duration<float, std::micro>(now - start).count();
+		start = now;
+		return micros;
+	}
+} // namespace
+
+//Define id counter
+unsigned int Simulation::mUniqueId = 0;
+
+void Simulation::init(size_t maxPlayers, size_t maxCollectibles, unsigned seed)
+{
+	mMaxPlayers = maxPlayers;
+	mMaxCollectibles = maxCollectibles;
+
+	mIdPoints.reserve(mMaxPlayers);
+	mCollectPool.init(static_cast<float>(collisionDistance), mMaxCollectibles);
+	mCollisionEvents.reserve(mMaxCollectibles);
+	mScoringPlayers.reserve(mMaxPlayers);
+	mCollisionScratch.resize(mThreadPool->getMaxRanges());
+	SimLog::info(std::string("Collision narrow phase using ") + ConeTest::instructionSet());
+	mPlayers.reserve(mMaxPlayers);
+	mPosGenerator.init(seed);
+	mSpawnPositions.reserve(mMaxPlayers);
+}
+
+void Simulation::detectCollisions()
+{
+	ZoneScoped;
+	findCollisions();
+	resolveCollisions();
+	applyCollisions();
+}
+
+void Simulation::findCollisions()
+{
+	ZoneScoped;
+	mCollisionEvents.clear();
+	if (mPlayers.empty() || mCollectPool.getNumEnabled() == 0)
+		return;
+
+	for (CollisionScratch& scratch : mCollisionScratch)
+	{
+		scratch.mEvents.clear();
+		if (scratch.mConeHits.size() < mCollectPool.getNumEnabled())
+			scratch.mConeHits.resize(mCollectPool.getNumEnabled());
+	}
+
+	const SphereGrid& grid = mCollectPool.getGrid();
+	const float collisionCos = static_cast<float>(std::cos(collisionDistance));
+
+	//Only reads players and collectibles, every range writes to its own scratch
+	constexpr size_t minPlayersPerRange = 16;
+	mThreadPool->parallelFor(mPlayers.size(), minPlayersPerRange,
+		[&](unsigned rangeIndex, size_t begin, size_t end)
+	{
+		CollisionScratch& scratch = mCollisionScratch[rangeIndex];
+		for (size_t i = begin; i < end; i++)
+		{
+			const glm::vec3 playerDirection = mPlayers[i].getDirection();
+
+			//Only collectibles in cells overlapping the player's collision cone are tested,
+			//a collision is when the angle between the directions is below collisionDistance
+			grid.forEachCandidateCell(playerDirection, [&](const SphereGrid::Cell& cell)
+			{
+				const size_t numHits = ConeTest::findHits(cell.mXs.data(), cell.mYs.data(), cell.mZs.data(),
+					cell.mSlots.size(), playerDirection, collisionCos, scratch.mConeHits.data());
+
+				for (size_t k = 0; k < numHits; k++)
+				{
+					const unsigned entry = scratch.mConeHits[k];
+					const float closeness = cell.mXs[entry] * playerDirection.x
+						+ cell.mYs[entry] * playerDirection.y + cell.mZs[entry] * playerDirection.z;
+					scratch.mEvents.push_back({ static_cast<unsigned>(i), cell.mSlots[entry], closeness });
+				}
+			});
+		}
+	});
+
+	for (const CollisionScratch& scratch : mCollisionScratch)
+		mCollisionEvents.insert(mCollisionEvents.end(), scratch.mEvents.begin(), scratch.mEvents.end());
+}
+
+void Simulation::resolveCollisions()
+{
+	ZoneScoped;
+	//Descending slot, then closest player first and lowest id on ties. This is a total
+	//order so the winners do not depend on the order events were found in
+	std::sort(mCollisionEvents.begin(), mCollisionEvents.end(),
+		[](const CollisionEvent& a, const CollisionEvent& b)
+		{
+			if (a.mSlot != b.mSlot)
+				return a.mSlot > b.mSlot;
+			if (a.mCloseness != b.mCloseness)
+				return a.mCloseness > b.mCloseness;
+			return a.mPlayer < b.mPlayer;
+		});
+
+	mCollisionEvents.erase(std::unique(mCollisionEvents.begin(), mCollisionEvents.end(),
+		[](const CollisionEvent& a, const CollisionEvent& b) { return a.mSlot == b.mSlot; }),
+		mCollisionEvents.end());
+}
+
+void Simulation::applyCollisions()
+{
+	ZoneScoped;
+	//Events are in descending slot order so the swaps never move a pending collectible
+	mScoringPlayers.clear();
+	for (const CollisionEvent& event : mCollisionEvents)
+	{
+		mCollectPool.disableCollectibleAndSwap(event.mSlot);
+		mPlayers[event.mPlayer].addPoints();
+		mScoringPlayers.push_back(event.mPlayer);
+	}
+
+	//Report the new total once per scoring player
+	std::sort(mScoringPlayers.begin(), mScoringPlayers.end());
+	mScoringPlayers.erase(std::unique(mScoringPlayers.begin(), mScoringPlayers.end()), mScoringPlayers.end());
+	for (unsigned player : mScoringPlayers)
+		mIdPoints.push_back(std::make_pair(player, mPlayers[player].getPoints()));
+}
+
+void Simulation::processEvents(float currentTime)
+{
+	ZoneScoped;
+	using EventType = EventScheduler::EventType;
+	mEvents.runDue(currentTime, [&](const EventScheduler::Event& event)
+	{
+		switch (event.mType)
+		{
+		case EventType::SPAWN:
+			spawnBatch(currentTime);
+			//Reschedule from the due time so slices do not drift with the tick rate
+			mEvents.schedule(event.mTime + mSpawnInterval / mSpawnSlices, EventType::SPAWN);
+			break;
+		case EventType::DESPAWN:
+			mCollectPool.disableCollectibleWithSeed(event.mPayload);
+			break;
+		case EventType::ROUNDEND:
+			endGame();
+			break;
+		}
+	});
+}
+
+void Simulation::spawnBatch(float currentTime)
+{
+	ZoneScoped;
+	mSpawnCredit += static_cast<float>(mPlayers.size()) / mSpawnSlices;
+	const size_t numToSpawn = static_cast<size_t>(mSpawnCredit);
+	mSpawnCredit -= numToSpawn;
+
+	//Collectibles get consecutive seeds, their positions follow from them
+	const unsigned firstSeed = mCollectPool.getNextSeed();
+	mSpawnPositions.clear();
+	for (size_t i = 0; i < numToSpawn; i++)
+		mSpawnPositions.push_back(getCollectiblePosition(getSpawnSeed(), firstSeed + static_cast<unsigned>(i)));
+
+	const size_t numSpawned = mCollectPool.enableCollectibles(mSpawnPositions, currentTime);
+
+	if (mCollectibleLifetime > 0.f)
+	{
+		for (size_t i = 0; i < numSpawned; i++)
+		{
+			mEvents.schedule(currentTime + mCollectibleLifetime, EventScheduler::EventType::DESPAWN,
+				firstSeed + static_cast<unsigned>(i));
+		}
+	}
+}
+
+void Simulation::addPlayer()
+{
+	mPlayers.emplace_back();
+	++mUniqueId;
+}
+
+void Simulation::addCollectible()
+{
+	mCollectPool.enableCollectible(getCollectiblePosition(getSpawnSeed(), mCollectPool.getNextSeed()), mTotalTime);
+}
+
+glm::quat Simulation::getCollectiblePosition(unsigned spawnSeed, unsigned collectSeed)
+{
+	return glm::quat(PositionGenerator::generatePos(spawnSeed, collectSeed));
+}
+
+void Simulation::addPlayer(const glm::vec3& pos)
+{
+	mPlayers.push_back(Player{ DOMERADIUS, pos, 0.f, "Player " + std::to_string(mUniqueId), 0.5 });
+	++mUniqueId;
+}
+
+void Simulation::addPlayer(const PlayerMetadata& newMetadata, const PositionData& newPosData)
+{
+	//Create player from PositionData object
+	mPlayers.emplace_back(newMetadata, newPosData);
+}
+
+void Simulation::addPlayer(std::tuple<unsigned int, std::string>&& inputTuple)
+{
+	assert(std::get<0>(inputTuple) == mPlayers.size() && "Player creation desync (id out of bounds: mPlayers)");
+	if (mPlayers.size() == mMaxPlayers)
+		SimLog::info("More than maxPlayers=" + std::to_string(mMaxPlayers) + " players, raise it in config.ini");
+	mPlayers.emplace_back(std::get<1>(inputTuple), mPosGenerator.generatePos());
+}
+
+void Simulation::advance(float frameTime)
+{
+	ZoneScoped;
+	mTickStats = TickStats{};
+	if (!mGameIsStarted || mGameIsEnded)
+		return;
+
+	mAccumulator += frameTime;
+
+	//Simulate in fixed steps, a slow frame is caught up with at most mMaxCatchUpSteps
+	unsigned steps = 0;
+	while (mAccumulator >= mTickLength && steps < mMaxCatchUpSteps && !mGameIsEnded)
+	{
+		tick(mTickLength);
+		mAccumulator -= mTickLength;
+		++steps;
+	}
+
+	//Drop time that could not be caught up with instead of spiralling
+	if (mAccumulator >= mTickLength)
+		mAccumulator = std::fmod(mAccumulator, mTickLength);
+
+	//Render state lies this far between the last two simulated states
+	mRenderAlpha = mAccumulator / mTickLength;
+}
+
+void Simulation::tick(float deltaTime)
+{
+	ZoneScoped;
+	this->mTotalTime += deltaTime;
+	Clock::time_point start = Clock::now();
+
+	processEvents(mTotalTime);
+	mTickStats.mEventsTime += lapMicroseconds(start);
+	updatePlayers(deltaTime);
+	mTickStats.mPlayersTime += lapMicroseconds(start);
+
+	//TODO Update other type of objects
+
+	detectCollisions();
+	mTickStats.mCollisionsTime += lapMicroseconds(start);
+	++mTickStats.mNumTicks;
+}
+
+void Simulation::updatePlayers(float deltaTime)
+{
+	ZoneScoped;
+	//Players only read and write their own state so they can be updated in any order
+	constexpr size_t minPlayersPerRange = 32;
+	mThreadPool->parallelFor(mPlayers.size(), minPlayersPerRange, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			mPlayers[i].update(deltaTime);
+	});
+}
+
+void Simulation::setSyncedTime(float renderTime)
+{
+	//Players keep moving between the frames master syncs them in
+	const float deltaTime = renderTime - mTotalTime;
+	if (deltaTime > 0.f)
+	{
+		for (Player& player : mPlayers)
+			player.extrapolate(deltaTime);
+	}
+
+	mTotalTime = renderTime;
+	mRenderAlpha = 1.f;
+}
+
+void Simulation::setTickRate(float ticksPerSecond, unsigned maxCatchUpSteps)
+{
+	assert(ticksPerSecond > 0.f && maxCatchUpSteps > 0 && "Invalid simulation tick rate");
+	mTickLength = 1.f / ticksPerSecond;
+	mMaxCatchUpSteps = maxCatchUpSteps;
+}
+
+void Simulation::setNumWorkers(unsigned numWorkers)
+{
+	if (numWorkers == mThreadPool->getNumWorkers())
+		return;
+
+	mThreadPool = std::make_unique<ThreadPool>(numWorkers);
+	mCollisionScratch.resize(mThreadPool->getMaxRanges());
+	SimLog::info("Simulation updating with " + std::to_string(numWorkers) + " worker threads");
+}
+
+std::string Simulation::getLeaderboard() const
+{
+	//Alias for pair of player name and points
+	using pointPair = std::pair<std::string, int>;
+
+	std::stringstream output;
+
+	std::vector<pointPair> sortedPlayersAndPoints;
+	sortedPlayersAndPoints.reserve(mPlayers.size());
+
+	//Make pairs of each players name and points
+	for (const auto& player : mPlayers)
+	{
+		sortedPlayersAndPoints.push_back(std::make_pair(player.getName(), player.getPoints()));
+	}
+
+	//Sort decreasingly
+	std::sort(sortedPlayersAndPoints.begin(), sortedPlayersAndPoints.end(),
+		[](const pointPair& a, const pointPair& b)
+		{
+			return a.second > b.second;
+		});
+
+	for (size_t i = 0; i < sortedPlayersAndPoints.size(); i++)
+	{
+		output << std::setw(20) << std::left << sortedPlayersAndPoints[i].first;
+		output << " - " << std::setw(8) << std::right << sortedPlayersAndPoints[i].second;
+		output << "\n";
+
+		if (i >= 10)
+			break;
+	}
+
+	return output.str();
+}
+
+void Simulation::startGame()
+{
+	this->mTotalTime = 0;
+	this->mGameIsStarted = true;
+
+	mEvents.clear();
+	mSpawnCredit = 0.f;
+	mEvents.schedule(0.f, EventScheduler::EventType::SPAWN);
+	mEvents.schedule(mMaxTime, EventScheduler::EventType::ROUNDEND);
+}
+
+void Simulation::setSpawnSchedule(float interval, unsigned slices, float lifetime)
+{
+	assert(interval > 0.f && slices > 0 && "Invalid spawn schedule");
+	mSpawnInterval = interval;
+	mSpawnSlices = slices;
+	mCollectibleLifetime = lifetime;
+}
+
+float Simulation::getPassedTime()
+{
+	float var = this->mTotalTime/this->mMaxTime;
+	float value = (int)(var * 100 + .5);
+	return (float)value / 100;
+}
+
+bool Simulation::shouldSendTime()
+{
+	if (mTotalTime - mLastTime > 1) {
+		mLastTime = mTotalTime;
+		return true;
+		
+	}
+	return false;
+}
+
+void Simulation::updateTurnSpeed(std::tuple<unsigned int, float>&& input)
+{
+	unsigned id = std::get<0>(input);
+	float rotAngle = std::get<1>(input);
+
+	assert(id < mPlayers.size() && "Player update turn speed desync (id out of bounds mPlayers");
+
+	mPlayers[id].setTurnSpeed(rotAngle);
+}
+
+void Simulation::enablePlayer(unsigned id)
+{
+	assert(id < mPlayers.size() && "Player disable desync (id out of bounds mPlayers");
+	mPlayers[id].enablePlayer();
+}
+
+void Simulation::disablePlayer(unsigned id)
+{
+	assert(id < mPlayers.size() && "Player disable desync (id out of bounds mPlayers");
+	mPlayers[id].disablePlayer();
+}
+
+void Simulation::rotateAllPlayers(float newOrientation)
+{
+	for (auto& player : mPlayers)
+	{
+		player.setOrientation(player.getOrientation() + newOrientation);
+	}
+}
+
+std::pair<glm::vec3, glm::vec3> Simulation::getPlayerColours(unsigned id)
+{
+    assert(id < mPlayers.size() && "Player get colours desync (id out of bounds mPlayers");
+    return mPlayers[id].getColours();
+}
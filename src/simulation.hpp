@@ -0,0 +1,281 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <tuple>
+#include <random>
+#include <cstddef>
+#include <memory>
+
+#include <glm/glm.hpp>
+
+#include "profiling.hpp"
+#include "player.hpp"
+#include "collectiblepool.hpp"
+#include "threadpool.hpp"
+#include "eventscheduler.hpp"
+
+//All game logic that does not need a window, GL or a network connection:
+//players, collectibles, spawning, collisions, scoring and sync state
+//Game extends this with rendering, benchmarks and tools use it directly
+class Simulation
+{
+public:
+	Simulation() = default;
+
+	//Allocate pools and seed spawn position generator
+	//maxPlayers only pre-sizes buffers, more players can join at the cost of reallocation
+	//maxCollectibles is the most collectibles that can be enabled at once
+	void init(size_t maxPlayers, size_t maxCollectibles, unsigned seed = std::random_device{}());
+
+	//Used for debugging
+	void addPlayer();
+	void addCollectible();
+
+	void addPlayer(const glm::vec3& pos);
+
+	//Add player from synced metadata and position on render nodes
+	void addPlayer(const PlayerMetadata& newMetadata,
+				   const PositionData& newPosData);
+
+	//Add player from server request
+	void addPlayer(std::tuple<unsigned int, std::string>&& inputTuple);
+
+	//enable/disable player
+	void enablePlayer(unsigned id);
+	void disablePlayer(unsigned id);
+
+	//Advance the simulation in fixed steps by frameTime seconds
+	void advance(float frameTime);
+
+	//Wall time of the phases of the steps the last advance() took, in microseconds
+	struct TickStats
+	{
+		unsigned mNumTicks = 0;
+		float mEventsTime = 0.f;
+		float mPlayersTime = 0.f;
+		float mCollisionsTime = 0.f;
+	};
+	const TickStats& getTickStats() const { return mTickStats; }
+
+	//Advance all gameobjects one fixed step, runs the phases below in order
+	void tick(float deltaTime);
+
+	//Simulation phases, public so they can be timed separately
+	//processEvents runs all scheduled events due at or before currentTime
+	void processEvents(float currentTime);
+	void updatePlayers(float deltaTime);
+	void detectCollisions();
+
+	//Get leaderboard string
+	//Only gets called at end of game
+	std::string getLeaderboard() const;
+
+	//Check if game has ended
+	bool hasGameEnded() const { return mGameIsEnded; }
+
+	//End the game (stop updating state)
+	void endGame() { mGameIsEnded = true; }
+
+	//Set game time, the round end is scheduled when the game starts
+	void setMaxTime(float time) { mMaxTime = time; }
+
+	//Every interval seconds one collectible per player is spawned, split into slices
+	//batches spread evenly over the interval. Collectibles not picked up within
+	//lifetime seconds despawn, 0 keeps them until they are picked up
+	void setSpawnSchedule(float interval, unsigned slices, float lifetime);
+
+	//Set simulation steps per second and how many steps a slow frame may catch up with
+	void setTickRate(float ticksPerSecond, unsigned maxCatchUpSteps);
+	float getTickLength() const { return mTickLength; }
+
+	//Number of extra threads for player updates and collision detection, 0 runs on the calling thread
+	//Results do not depend on the number of workers
+	void setNumWorkers(unsigned numWorkers);
+	unsigned getNumWorkers() const { return mThreadPool->getNumWorkers(); }
+
+	//Set the turn speed of player player with id id
+	void updateTurnSpeed(std::tuple<unsigned int, float>&& input);
+
+	//DEBUGGING TOOL: apply orientation to all GameObjects
+	void rotateAllPlayers(float deltaOrientation);
+
+    //Get and return player-colours
+    std::pair<glm::vec3, glm::vec3> getPlayerColours(unsigned id);
+
+	//Player ids and new points of players that scored since clearIdPoints()
+	const std::vector<std::pair<unsigned, int>>& getIdPoints() const { return mIdPoints; }
+	void clearIdPoints() { mIdPoints.clear(); }
+
+	//Log collectible spawns and collects for SyncEncoder, clear the log after each frame
+	void setCollectEventLogging(bool enabled) { mCollectPool.setEventLogging(enabled); }
+	void clearCollectEvents() { mCollectPool.clearEvents(); }
+
+	//Where the collectible with seed collectSeed spawns in a simulation seeded with
+	//spawnSeed. Render nodes place the collectibles of spawn events with it
+	static glm::quat getCollectiblePosition(unsigned spawnSeed, unsigned collectSeed);
+	unsigned getSpawnSeed() const { return mPosGenerator.mSeed; }
+
+	//Half angle (radians) of the cone around a player in which collectibles are hit
+	static constexpr float getCollisionAngle() { return static_cast<float>(collisionDistance); }
+
+	//Limits given to init
+	size_t getMaxPlayers() const { return mMaxPlayers; }
+	size_t getMaxCollectibles() const { return mMaxCollectibles; }
+
+	//start timer
+	void startGame();
+	float getPassedTime();
+	bool shouldSendTime();
+
+	//Accessors
+	const std::vector<Player>& getPlayers() const { return mPlayers; }
+	const CollectiblePool& getCollectPool() const { return mCollectPool; }
+
+	//Write access for SyncDecoder on render nodes, which follow master instead of simulating
+	Player& getSyncedPlayer(size_t index) { return mPlayers[index]; }
+	CollectiblePool& getSyncedCollectPool() { return mCollectPool; }
+	float getRenderAlpha() const { return mRenderAlpha; }
+
+	//Simulation time of the state that is rendered, between the last two steps on master
+	float getRenderTime() const { return mTotalTime - (1.f - mRenderAlpha) * mTickLength; }
+
+	//Clients do not step the simulation and follow the render time of master
+	//Players are extrapolated to renderTime, call before applying the frame synced with it
+	void setSyncedTime(float renderTime);
+
+protected:
+	//All players stored sequentually
+	std::vector<Player> mPlayers;
+
+	//Pool of collectibles for fast "generation" of objects
+	CollectiblePool mCollectPool;
+
+	//How far between the last two simulated states rendering is, 1 on clients
+	float mRenderAlpha = 1.f;
+
+	bool mGameIsStarted = false;
+
+private:
+//Members
+	//Has the game ended?
+	bool mGameIsEnded = false;
+
+	//GameObjects unique id generator for player tagging
+	//Deprecated
+	static unsigned int mUniqueId;
+
+	//Container to store player id and new points
+	//Data sent to server to update score on each player's phone
+	std::vector<std::pair<unsigned, int>> mIdPoints;
+
+	//A collectible inside the collision cone of a player
+	struct CollisionEvent
+	{
+		unsigned mPlayer;
+		unsigned mSlot;
+
+		//Cosine of the angle between player and collectible, larger is closer
+		float mCloseness;
+	};
+
+	//Buffers of one range of players in findCollisions()
+	struct CollisionScratch
+	{
+		std::vector<CollisionEvent> mEvents;
+
+		//Output of ConeTest::findHits, room for every enabled collectible
+		std::vector<unsigned> mConeHits;
+	};
+	std::vector<CollisionScratch> mCollisionScratch;
+
+	//All events of this tick, after resolveCollisions() at most one per collectible
+	std::vector<CollisionEvent> mCollisionEvents;
+
+	//Players that scored this tick
+	std::vector<unsigned> mScoringPlayers;
+
+	//Limits given to init
+	size_t mMaxPlayers = 0;
+	size_t mMaxCollectibles = 0;
+
+	//Length of one simulation step and max steps per advance (see setTickRate)
+	float mTickLength = 1.f / 60.f;
+	unsigned mMaxCatchUpSteps = 5;
+
+	//Workers for the parallel update phases
+	std::unique_ptr<ThreadPool> mThreadPool = std::make_unique<ThreadPool>(0);
+
+	//Frame time not yet simulated, always less than mTickLength after advance()
+	float mAccumulator = 0.f;
+
+	//See getTickStats
+	TickStats mTickStats;
+
+	//Half angle (radians) of the cone around a player in which collectibles are hit
+	static constexpr double collisionDistance = 0.1f; //TODO make this object specific
+
+	float mTotalTime = 0, mMaxTime = 60;//seconds
+	float mLastTime = 0;
+
+	//Spawns, despawns and round end
+	EventScheduler mEvents;
+
+	//See setSpawnSchedule
+	float mSpawnInterval = 4.f;
+	unsigned mSpawnSlices = 1;
+	float mCollectibleLifetime = 0.f;
+
+	//Collectibles owed to players that did not add up to a whole one in earlier slices
+	float mSpawnCredit = 0.f;
+
+	//Positions of the batch being spawned
+	std::vector<glm::quat> mSpawnPositions;
+
+//Functions
+	//Collision stages run by detectCollisions()
+	//Find every player/collectible overlap without changing any state
+	void findCollisions();
+	//Keep one event per collectible, won by the closest player
+	void resolveCollisions();
+	//Disable hit collectibles and score their players
+	void applyCollisions();
+
+	//Enable this slice's share of collectibles and schedule their despawn
+	void spawnBatch(float currentTime);
+
+	struct PositionGenerator
+	{
+		void init(unsigned seed)
+		{
+			mSeed = seed;
+			gen = std::mt19937(seed);
+			rng = std::uniform_real_distribution<>(-1.5f, 1.5f);
+		}
+
+		//RNG stuff
+		std::mt19937 gen;
+		std::uniform_real_distribution<> rng;
+
+		glm::vec3 generatePos()
+		{
+			ZoneScoped;
+			return glm::vec3(1.5f + rng(gen), rng(gen), 0.f);
+		}
+
+		//Collectible positions only depend on the seeds, so every node can reproduce them
+		//Hashed instead of drawn from gen, whose distributions differ between standard
+		//libraries and which is slow to reseed
+		static glm::vec3 generatePos(unsigned seed, unsigned collectSeed)
+		{
+			const unsigned hash = CollectiblePool::hashSeed(seed * 0x9E3779B9u + collectSeed);
+			const float x = 3.f * CollectiblePool::unitFloat(hash) - 1.5f;
+			const float y = 3.f * CollectiblePool::unitFloat(CollectiblePool::hashSeed(hash)) - 1.5f;
+			return glm::vec3(1.5f + x, y, 0.f);
+		}
+
+		unsigned mSeed = 0;
+
+	} mPosGenerator;
+};
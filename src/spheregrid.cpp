@@ -0,0 +1,181 @@
+#include "spheregrid.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include <glm/gtc/constants.hpp>
+
+namespace
+{
+	//Angle between two unit vectors
+	float angleBetween(const glm::vec3& a, const glm::vec3& b)
+	{
+		return std::acos(glm::clamp(glm::dot(a, b), -1.f, 1.f));
+	}
+}
+
+void SphereGrid::init(unsigned resolution, float queryAngle, size_t numSlots)
+{
+	assert(resolution > 0 && "Sphere grid needs at least one cell per face");
+
+	mResolution = resolution;
+	mQueryAngle = queryAngle;
+	mCells.clear();
+	mCells.resize(6 * static_cast<size_t>(mResolution) * mResolution);
+	mSlotCell.assign(numSlots, mNOCELL);
+	mSlotEntry.assign(numSlots, 0);
+
+	//Cell geometry in warped face coordinates
+	const float cellSize = 2.f / mResolution;
+	for (unsigned face = 0; face < 6; ++face)
+	{
+		for (unsigned j = 0; j < mResolution; ++j)
+		{
+			for (unsigned i = 0; i < mResolution; ++i)
+			{
+				Cell& cell = mCells[(static_cast<size_t>(face) * mResolution + j) * mResolution + i];
+				const float u0 = -1.f + i * cellSize;
+				const float v0 = -1.f + j * cellSize;
+
+				cell.mCenter = faceToDirection(face, u0 + 0.5f * cellSize, v0 + 0.5f * cellSize);
+
+				//Cell edges are great circle arcs so the farthest point is a corner,
+				//edge midpoints are included and a small margin added to stay conservative
+				float radius = 0.f;
+				for (unsigned corner = 0; corner < 9; ++corner)
+				{
+					const float u = u0 + 0.5f * cellSize * (corner % 3);
+					const float v = v0 + 0.5f * cellSize * (corner / 3);
+					radius = std::max(radius, angleBetween(cell.mCenter, faceToDirection(face, u, v)));
+				}
+				cell.mRadius = radius * 1.01f;
+				cell.mQueryCos = std::cos(std::min(cell.mRadius + mQueryAngle, glm::pi<float>()));
+			}
+		}
+	}
+
+	//Any cell a query cone from inside the home cell can reach
+	for (size_t home = 0; home < mCells.size(); ++home)
+	{
+		for (size_t other = 0; other < mCells.size(); ++other)
+		{
+			const float reach = mCells[home].mRadius + mCells[other].mRadius + mQueryAngle;
+			if (angleBetween(mCells[home].mCenter, mCells[other].mCenter) <= reach)
+				mCells[home].mNeighbours.push_back(static_cast<unsigned>(other));
+		}
+	}
+}
+
+void SphereGrid::resizeSlots(size_t numSlots)
+{
+	assert(numSlots >= mSlotCell.size() && "Sphere grid can not shrink while in use");
+	mSlotCell.resize(numSlots, mNOCELL);
+	mSlotEntry.resize(numSlots, 0);
+}
+
+void SphereGrid::insert(size_t slot, const glm::vec3& direction)
+{
+	assert(slot < mSlotCell.size() && "Sphere grid slot out of bounds");
+	assert(mSlotCell[slot] == mNOCELL && "Sphere grid slot already occupied");
+
+	const size_t cellIdx = cellIndex(direction);
+	Cell& cell = mCells[cellIdx];
+
+	mSlotCell[slot] = static_cast<unsigned>(cellIdx);
+	mSlotEntry[slot] = static_cast<unsigned>(cell.mSlots.size());
+	cell.mSlots.push_back(static_cast<unsigned>(slot));
+	cell.mXs.push_back(direction.x);
+	cell.mYs.push_back(direction.y);
+	cell.mZs.push_back(direction.z);
+}
+
+void SphereGrid::remove(size_t slot)
+{
+	assert(slot < mSlotCell.size() && "Sphere grid slot out of bounds");
+	if (mSlotCell[slot] == mNOCELL)
+		return;
+
+	//Swap with last entry in the cell to remove in constant time
+	Cell& cell = mCells[mSlotCell[slot]];
+	const unsigned entry = mSlotEntry[slot];
+	const unsigned lastSlot = cell.mSlots.back();
+
+	cell.mSlots[entry] = lastSlot;
+	cell.mXs[entry] = cell.mXs.back();
+	cell.mYs[entry] = cell.mYs.back();
+	cell.mZs[entry] = cell.mZs.back();
+	mSlotEntry[lastSlot] = entry;
+
+	cell.mSlots.pop_back();
+	cell.mXs.pop_back();
+	cell.mYs.pop_back();
+	cell.mZs.pop_back();
+
+	mSlotCell[slot] = mNOCELL;
+}
+
+void SphereGrid::move(size_t from, size_t to)
+{
+	assert(from < mSlotCell.size() && to < mSlotCell.size() && "Sphere grid slot out of bounds");
+	assert(mSlotCell[to] == mNOCELL && "Sphere grid move target is occupied");
+	if (from == to || mSlotCell[from] == mNOCELL)
+		return;
+
+	mCells[mSlotCell[from]].mSlots[mSlotEntry[from]] = static_cast<unsigned>(to);
+	mSlotCell[to] = mSlotCell[from];
+	mSlotEntry[to] = mSlotEntry[from];
+	mSlotCell[from] = mNOCELL;
+}
+
+void SphereGrid::clear()
+{
+	for (Cell& cell : mCells)
+	{
+		cell.mSlots.clear();
+		cell.mXs.clear();
+		cell.mYs.clear();
+		cell.mZs.clear();
+	}
+	std::fill(mSlotCell.begin(), mSlotCell.end(), mNOCELL);
+}
+
+size_t SphereGrid::cellIndex(const glm::vec3& direction) const
+{
+	//Major axis decides the face
+	const glm::vec3 absDir = glm::abs(direction);
+	unsigned axis = 2;
+	if (absDir.x >= absDir.y && absDir.x >= absDir.z)
+		axis = 0;
+	else if (absDir.y >= absDir.z)
+		axis = 1;
+
+	const float major = absDir[axis];
+	const unsigned face = 2 * axis + (direction[axis] < 0.f ? 1 : 0);
+	if (major <= 0.f)
+		return 0;
+
+	//Warp face coordinates to even out cell sizes
+	constexpr float warp = 4.f / glm::pi<float>();
+	const float u = std::atan(direction[(axis + 1) % 3] / major) * warp;
+	const float v = std::atan(direction[(axis + 2) % 3] / major) * warp;
+
+	const int maxCell = static_cast<int>(mResolution) - 1;
+	const int i = glm::clamp(static_cast<int>((u + 1.f) * 0.5f * mResolution), 0, maxCell);
+	const int j = glm::clamp(static_cast<int>((v + 1.f) * 0.5f * mResolution), 0, maxCell);
+
+	return (static_cast<size_t>(face) * mResolution + j) * mResolution + i;
+}
+
+glm::vec3 SphereGrid::faceToDirection(unsigned face, float u, float v) const
+{
+	const unsigned axis = face / 2;
+	constexpr float unwarp = glm::pi<float>() / 4.f;
+
+	glm::vec3 direction{ 0.f };
+	direction[axis] = (face % 2 == 0) ? 1.f : -1.f;
+	direction[(axis + 1) % 3] = std::tan(u * unwarp);
+	direction[(axis + 2) % 3] = std::tan(v * unwarp);
+
+	return glm::normalize(direction);
+}
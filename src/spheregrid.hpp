@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+//Broad-phase acceleration structure for objects on the surface of the dome sphere
+//Directions are binned into a cube map with mResolution x mResolution cells per face.
+//Cells are warped with atan to get roughly equal solid angles over the whole face.
+//Objects are referenced by their slot (e.g. index in CollectiblePool) and the grid
+//is updated incrementally when objects are inserted, removed or moved between slots
+class SphereGrid
+{
+public:
+	SphereGrid() = default;
+
+	struct Cell
+	{
+		//Slots of all objects located in this cell
+		std::vector<unsigned> mSlots;
+
+		//Unit directions of the objects in mSlots, one array per component
+		std::vector<float> mXs;
+		std::vector<float> mYs;
+		std::vector<float> mZs;
+
+		//Unit direction to the center of the cell
+		glm::vec3 mCenter;
+
+		//Largest angle between mCenter and any point in the cell
+		float mRadius;
+
+		//Cosine of mRadius + query angle, objects in this cell can only be hit by
+		//a query whose direction is closer than this to mCenter
+		float mQueryCos;
+
+		//All cells (including this) that a query cone from inside this cell can touch
+		std::vector<unsigned> mNeighbours;
+	};
+
+	//Build the cells and their neighbourhoods
+	//queryAngle is the largest angle (radians) a query cone may have,
+	//numSlots is the number of slots that may be referenced
+	void init(unsigned resolution, float queryAngle, size_t numSlots);
+
+	//Allow slots up to numSlots to be referenced, existing slots are kept
+	void resizeSlots(size_t numSlots);
+
+	//Insert object at slot with unit direction
+	void insert(size_t slot, const glm::vec3& direction);
+
+	//Remove object at slot
+	void remove(size_t slot);
+
+	//Object in slot from has been moved to slot to (which must be empty)
+	void move(size_t from, size_t to);
+
+	//Remove all objects
+	void clear();
+
+	//Calls func(cell) for every non-empty cell overlapping the query cone around
+	//direction. This is conservative, a narrow phase test is still needed
+	template<typename Func>
+	void forEachCandidateCell(const glm::vec3& direction, Func&& func) const
+	{
+		const Cell& home = mCells[cellIndex(direction)];
+		for (unsigned neighbour : home.mNeighbours)
+		{
+			const Cell& cell = mCells[neighbour];
+			if (cell.mSlots.empty() || glm::dot(direction, cell.mCenter) < cell.mQueryCos)
+				continue;
+
+			func(cell);
+		}
+	}
+
+	//Index of the cell containing direction
+	size_t cellIndex(const glm::vec3& direction) const;
+
+	//Accessors
+	size_t getNumCells() const { return mCells.size(); }
+
+private:
+	//Face and warped face coordinates in [-1, 1] to unit direction
+	glm::vec3 faceToDirection(unsigned face, float u, float v) const;
+
+	//Sentinel for slots not present in the grid
+	static constexpr unsigned mNOCELL = ~0u;
+
+	std::vector<Cell> mCells;
+
+	//For every slot, the cell it lives in and its position in that cell's mSlots
+	std::vector<unsigned> mSlotCell;
+	std::vector<unsigned> mSlotEntry;
+
+	unsigned mResolution = 0;
+	float mQueryAngle = 0.f;
+};
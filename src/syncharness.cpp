@@ -0,0 +1,475 @@
+//
+//  In-process cluster for testing sync without sgct
+//  Runs one master simulation and N render node simulations connected by an in-memory
+//  transport that carries the same frames encode() and decode() in main.cpp exchange,
+//  and reports sync latency, frame size, apply cost and whether the nodes converge
+//
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "simulation.hpp"
+#include "simlog.hpp"
+#include "threadpool.hpp"
+#include "syncstream.hpp"
+#include "syncstats.hpp"
+
+namespace {
+	struct HarnessConfig
+	{
+		unsigned numNodes = 6;
+		unsigned numPlayers = 110;
+		unsigned numCollectibles = 300;
+		float seconds = 20.f;
+		float tickRate = 60.f;
+		unsigned seed = 1;
+
+		//Threads decoding nodes besides the main thread, nodes are separate machines
+		//in a cluster so by default every node gets a thread of its own
+		int numWorkers = -1;
+
+		//Chance that a node misses a frame, nodes then wait for the next keyframe
+		//Frames are never dropped in the last keyframe interval, so every run can converge
+		float dropRate = 0.f;
+
+		unsigned keyframeInterval = 60;
+		unsigned playerSyncInterval = 4;
+		bool collectibleEvents = true;
+
+		//Run a grid of node and object counts instead of one configuration
+		bool sweep = false;
+		bool verbose = false;
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	//Stands in for sgct, which copies the frame of master to every node each frame
+	//A node that drops a frame receives nothing, as if its frame was lost
+	class MemoryTransport
+	{
+	public:
+		MemoryTransport(unsigned numNodes, float dropRate, unsigned seed)
+			: mInboxes(numNodes), mReceived(numNodes, false), mDropRate(dropRate), mRandom(seed)
+		{
+		}
+
+		//Nodes only drop the frame if allowDrop is set
+		void send(const std::vector<std::byte>& frame, bool allowDrop)
+		{
+			std::bernoulli_distribution drop(mDropRate);
+			for (size_t node = 0; node < mInboxes.size(); ++node)
+			{
+				mReceived[node] = !allowDrop || mDropRate <= 0.f || !drop(mRandom);
+				if (mReceived[node])
+					mInboxes[node].assign(frame.begin(), frame.end());
+			}
+		}
+
+		//Frame node got in the last send, false if it was dropped
+		bool receive(size_t node, ByteSpan& frame) const
+		{
+			if (!mReceived[node])
+				return false;
+			frame = ByteSpan(mInboxes[node]);
+			return true;
+		}
+
+	private:
+		//One buffer per node, reused between frames
+		std::vector<std::vector<std::byte>> mInboxes;
+		std::vector<bool> mReceived;
+
+		float mDropRate;
+		std::mt19937 mRandom;
+	};
+
+	struct Node
+	{
+		Simulation mSimulation;
+		SyncDecoder mDecoder;
+
+		//Microseconds from the start of encode until this node applied the frame
+		double mLatency = 0.0;
+		bool mApplied = false;
+
+		//Frames in a row this node did not match master, and the longest such run
+		unsigned mDivergedRun = 0;
+		unsigned mLongestDivergedRun = 0;
+		unsigned mNumDivergedFrames = 0;
+	};
+
+	struct HarnessResult
+	{
+		unsigned mNumFrames = 0;
+		unsigned long long mFrameBytes = 0;
+		unsigned mNumKeyframes = 0;
+		unsigned long long mKeyframeBytes = 0;
+
+		//Encode, node latency and apply cost of every frame
+		SyncStats mStats;
+		RollingHistogram mLatency;
+
+		//Rendered player position error on the nodes, includes extrapolation
+		double mPositionErrorSum = 0.0;
+		unsigned long long mNumPositionSamples = 0;
+		float mMaxPositionError = 0.f;
+
+		unsigned mNumDivergedFrames = 0;
+		unsigned mLongestDivergedRun = 0;
+		unsigned mNumSkippedFrames = 0;
+
+		//Keyframes after which a node still did not match, should never happen
+		unsigned mKeyframeMismatches = 0;
+
+		//Every node matched master after the last frame
+		bool mConverged = false;
+
+		HarnessResult(size_t window) : mStats(window), mLatency(window) {}
+	};
+
+	void printUsage()
+	{
+		std::printf(
+			"Usage: domedagen_syncharness [options]\n"
+			"  --nodes N         render nodes besides master (default 6)\n"
+			"  --players P       players, half join during the first seconds (default 110)\n"
+			"  --collectibles M  collectibles kept enabled (default 300)\n"
+			"  --seconds T       simulated time in seconds (default 20)\n"
+			"  --tickrate R      simulation steps and frames per second (default 60)\n"
+			"  --seed S          seed for spawn positions and dropped frames (default 1)\n"
+			"  --threads W       threads decoding nodes besides the main thread (default one per node)\n"
+			"  --drop F          chance that a node misses a frame (default 0)\n"
+			"  --keyframe N      frames between sync keyframes (default 60)\n"
+			"  --player-sync N   frames between player position updates (default 4)\n"
+			"  --collect-states  sync collectible states instead of events\n"
+			"  --sweep           run 1 to N nodes with a quarter, half and all of P and M\n"
+			"  --verbose         print simulation log messages\n");
+	}
+
+	bool parseArguments(int argc, char** argv, HarnessConfig& config)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+
+			if (arg == "--nodes" && hasValue)
+				config.numNodes = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--players" && hasValue)
+				config.numPlayers = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--collectibles" && hasValue)
+				config.numCollectibles = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--seconds" && hasValue)
+				config.seconds = std::stof(argv[++i]);
+			else if (arg == "--tickrate" && hasValue)
+				config.tickRate = std::stof(argv[++i]);
+			else if (arg == "--seed" && hasValue)
+				config.seed = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--threads" && hasValue)
+				config.numWorkers = std::stoi(argv[++i]);
+			else if (arg == "--drop" && hasValue)
+				config.dropRate = std::stof(argv[++i]);
+			else if (arg == "--keyframe" && hasValue)
+				config.keyframeInterval = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--player-sync" && hasValue)
+				config.playerSyncInterval = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--collect-states")
+				config.collectibleEvents = false;
+			else if (arg == "--sweep")
+				config.sweep = true;
+			else if (arg == "--verbose")
+				config.verbose = true;
+			else
+				return false;
+		}
+		return config.numNodes > 0 && config.tickRate > 0.f && config.seconds > 0.f
+			&& config.dropRate >= 0.f && config.dropRate < 1.f;
+	}
+
+	//Same steering as the benchmark, every player weaves with its own frequency and phase
+	float scriptedTurnSpeed(unsigned player, float time)
+	{
+		const float frequency = 0.2f + 0.05f * (player % 7);
+		return 1.5f * std::sin(frequency * time + 0.7f * player);
+	}
+
+	//Angle of the rotation between a and b
+	float quatError(const PositionData& a, const PositionData& b)
+	{
+		const glm::quat d = glm::quat(a.mW, a.mX, a.mY, a.mZ) * glm::conjugate(glm::quat(b.mW, b.mX, b.mY, b.mZ));
+		const double vectorLength = std::sqrt(double(d.x) * d.x + double(d.y) * d.y + double(d.z) * d.z);
+		return static_cast<float>(2.0 * std::atan2(vectorLength, std::abs(double(d.w))));
+	}
+
+	unsigned frameCount(const HarnessConfig& config)
+	{
+		return static_cast<unsigned>(config.seconds * config.tickRate);
+	}
+
+	//True if node shows what master sent: the same players with the same points, names,
+	//colours and enabled state, and the same collectibles
+	//Positions only have to be close, their error is added to result
+	bool matchesMaster(const Simulation& master, const Simulation& node, HarnessResult& result)
+	{
+		const std::vector<Player>& sentPlayers = master.getPlayers();
+		const std::vector<Player>& players = node.getPlayers();
+		const CollectiblePool& sentPool = master.getCollectPool();
+		const CollectiblePool& pool = node.getCollectPool();
+		if (sentPlayers.size() != players.size() || sentPool.getNumEnabled() != pool.getNumEnabled())
+			return false;
+
+		for (size_t i = 0; i < players.size(); ++i)
+		{
+			if (sentPlayers[i].getPoints() != players[i].getPoints()
+				|| sentPlayers[i].isEnabled() != players[i].isEnabled()
+				|| sentPlayers[i].getName() != players[i].getName()
+				|| sentPlayers[i].getColours() != players[i].getColours())
+				return false;
+
+			const float error = quatError(sentPlayers[i].getPositionData(),
+				players[i].getInterpolatedPositionData(node.getRenderAlpha()));
+			result.mPositionErrorSum += error;
+			result.mMaxPositionError = std::max(result.mMaxPositionError, error);
+			++result.mNumPositionSamples;
+		}
+		for (size_t i = 0; i < pool.getNumEnabled(); ++i)
+		{
+			if (sentPool.getCollectibleData(i).mSeed != pool.getCollectibleData(i).mSeed)
+				return false;
+		}
+		return true;
+	}
+
+	//result has to be sized for the number of frames, see frameCount
+	void runCluster(const HarnessConfig& config, HarnessResult& result)
+	{
+		const unsigned numTicks = frameCount(config);
+
+		Simulation master;
+		master.init(config.numPlayers, config.numCollectibles, config.seed);
+		master.setMaxTime(config.seconds + 1.f);
+		master.setTickRate(config.tickRate, 1);
+		master.setCollectEventLogging(config.collectibleEvents);
+
+		SyncEncoder encoder;
+		encoder.setKeyframeInterval(config.keyframeInterval);
+		encoder.setPlayerSyncInterval(config.playerSyncInterval);
+		encoder.setCollectibleEvents(config.collectibleEvents);
+
+		//Nodes do not know the seed of master, it arrives with the frames
+		std::vector<std::unique_ptr<Node>> nodes;
+		for (unsigned i = 0; i < config.numNodes; ++i)
+		{
+			nodes.push_back(std::make_unique<Node>());
+			nodes.back()->mSimulation.init(config.numPlayers, config.numCollectibles, config.seed + 1 + i);
+		}
+
+		MemoryTransport transport(config.numNodes, config.dropRate, config.seed);
+		const unsigned numWorkers = config.numWorkers < 0 ? config.numNodes - 1 : config.numWorkers;
+		ThreadPool pool(numWorkers);
+
+		//Half the players are there from the start, the rest join one by one
+		const unsigned numInitialPlayers = config.numPlayers / 2;
+		for (unsigned i = 0; i < numInitialPlayers; ++i)
+			master.addPlayer(std::make_tuple(i, "player" + std::to_string(i)));
+		master.startGame();
+
+		const float tickLength = master.getTickLength();
+		std::vector<std::byte> frame;
+		for (unsigned tick = 0; tick < numTicks; ++tick)
+		{
+			const float time = tick * tickLength;
+
+			//Input master would get from the websocket server
+			const unsigned numPlayers = static_cast<unsigned>(master.getPlayers().size());
+			if (numPlayers < config.numPlayers && tick % 6 == 0)
+				master.addPlayer(std::make_tuple(numPlayers, "player" + std::to_string(numPlayers)));
+			for (unsigned i = 0; i < master.getPlayers().size(); ++i)
+				master.updateTurnSpeed(std::make_tuple(i, scriptedTurnSpeed(i, time)));
+			if (numPlayers > 0 && tick % 30 == 0)
+			{
+				const unsigned id = (tick / 30) % numPlayers;
+				if (master.getPlayers()[id].isEnabled())
+					master.disablePlayer(id);
+				else
+					master.enablePlayer(id);
+			}
+			while (master.getCollectPool().getNumEnabled() < config.numCollectibles)
+				master.addCollectible();
+
+			master.processEvents(time);
+			master.updatePlayers(tickLength);
+			master.detectCollisions();
+
+			//encode() in main.cpp
+			const Clock::time_point frameStart = Clock::now();
+			frame.clear();
+			const GameFrameHeader header{ false, false, true, time + tickLength };
+			header.write(frame);
+			encoder.encode(master, frame);
+			master.clearCollectEvents();
+			//No drops near the end so every node gets a keyframe before the last frame
+			transport.send(frame, tick + config.keyframeInterval + 1 < numTicks);
+
+			//decode() in main.cpp, on every node at once
+			pool.parallelFor(nodes.size(), 1, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+				{
+					Node& node = *nodes[i];
+					ByteSpan data;
+					node.mApplied = false;
+					if (!transport.receive(i, data))
+						continue;
+
+					ByteReader input(data, 0);
+					GameFrameHeader nodeHeader{};
+					if (!nodeHeader.read(input))
+						continue;
+					node.mSimulation.setSyncedTime(nodeHeader.mRenderTime);
+					size_t pos = input.getPos();
+					node.mApplied = node.mDecoder.decode(data, pos, node.mSimulation);
+					node.mLatency = std::chrono::duration<double, std::micro>(Clock::now() - frameStart).count();
+				}
+			});
+
+			//Latency of a frame is until the slowest node applied it, sgct waits for all
+			SyncFrameStats frameStats = encoder.getFrameStats();
+			double latency = 0.0;
+			for (const std::unique_ptr<Node>& nodePtr : nodes)
+			{
+				Node& node = *nodePtr;
+				if (node.mApplied)
+				{
+					latency = std::max(latency, node.mLatency);
+					const SyncFrameStats& decodeStats = node.mDecoder.getFrameStats();
+					frameStats.mDecodeTime = std::max(frameStats.mDecodeTime, decodeStats.mDecodeTime);
+					frameStats.mPlayerApplyTime = std::max(frameStats.mPlayerApplyTime, decodeStats.mPlayerApplyTime);
+					frameStats.mCollectibleApplyTime = std::max(frameStats.mCollectibleApplyTime,
+						decodeStats.mCollectibleApplyTime);
+				}
+
+				if (matchesMaster(master, node.mSimulation, result))
+					node.mDivergedRun = 0;
+				else
+				{
+					if (node.mApplied && node.mDecoder.getFrameStats().mIsKeyframe)
+						++result.mKeyframeMismatches;
+					++node.mNumDivergedFrames;
+					node.mLongestDivergedRun = std::max(node.mLongestDivergedRun, ++node.mDivergedRun);
+				}
+			}
+			result.mStats.add(frameStats);
+			result.mLatency.add(latency);
+
+			++result.mNumFrames;
+			result.mFrameBytes += frame.size();
+			if (encoder.wasKeyframe())
+			{
+				++result.mNumKeyframes;
+				result.mKeyframeBytes += frame.size();
+			}
+
+			master.clearIdPoints();
+		}
+
+		result.mConverged = true;
+		for (const std::unique_ptr<Node>& node : nodes)
+		{
+			result.mConverged = result.mConverged && node->mDivergedRun == 0;
+			result.mNumDivergedFrames += node->mNumDivergedFrames;
+			result.mLongestDivergedRun = std::max(result.mLongestDivergedRun, node->mLongestDivergedRun);
+			result.mNumSkippedFrames += node->mDecoder.getNumSkippedFrames();
+		}
+	}
+
+	//Nodes that drop frames wait for the next keyframe they receive, without drops they
+	//never diverge
+	bool passed(const HarnessResult& result, const HarnessConfig& config)
+	{
+		return result.mConverged && result.mKeyframeMismatches == 0
+			&& (config.dropRate > 0.f || result.mNumDivergedFrames == 0);
+	}
+
+	void printResult(const HarnessResult& result, const HarnessConfig& config)
+	{
+		const unsigned numDeltas = result.mNumFrames - result.mNumKeyframes;
+		std::printf("%u nodes, %u players, %u collectibles, %u frames, %.0f%% dropped per node\n",
+			config.numNodes, config.numPlayers, config.numCollectibles, result.mNumFrames, 100.0 * config.dropRate);
+		std::printf("  average       %10.0f bytes/frame\n", double(result.mFrameBytes) / result.mNumFrames);
+		std::printf("  keyframe      %10.0f bytes/frame\n",
+			result.mNumKeyframes ? double(result.mKeyframeBytes) / result.mNumKeyframes : 0.0);
+		std::printf("  delta         %10.0f bytes/frame\n",
+			numDeltas ? double(result.mFrameBytes - result.mKeyframeBytes) / numDeltas : 0.0);
+		std::printf("  latency       %10.1f us mean, p95 < %.0f us, max %.1f us\n", result.mLatency.getMean(),
+			result.mLatency.getPercentile(0.95), result.mLatency.getMax());
+		std::printf("  players       %10.2e rad mean error as rendered, %.2e max\n",
+			result.mNumPositionSamples ? result.mPositionErrorSum / result.mNumPositionSamples : 0.0,
+			result.mMaxPositionError);
+		std::printf("  diverged      %10u node frames, longest %u frames, %u frames skipped\n",
+			result.mNumDivergedFrames, result.mLongestDivergedRun, result.mNumSkippedFrames);
+		std::printf("  keyframes     %10u applied without matching master\n", result.mKeyframeMismatches);
+		std::printf("  converged     %10s\n", result.mConverged ? "yes" : "NO");
+		std::printf("per frame, node times are of the slowest node, p95 is a power of two upper bound\n%s",
+			result.mStats.getSummary().c_str());
+	}
+
+	//Grow nodes and objects separately so the cost of each shows
+	bool printSweep(const HarnessConfig& config)
+	{
+		std::printf("%6s %8s %12s %12s %12s %12s %12s  %s\n", "nodes", "players", "collectibles",
+			"bytes/frame", "encode us", "apply us", "latency us", "converged");
+
+		bool ok = true;
+		for (unsigned objectShare = 1; objectShare <= 4; objectShare *= 2)
+		{
+			for (unsigned numNodes = 1; numNodes <= config.numNodes; numNodes *= 2)
+			{
+				HarnessConfig run = config;
+				run.numNodes = numNodes;
+				run.numPlayers = config.numPlayers * objectShare / 4;
+				run.numCollectibles = config.numCollectibles * objectShare / 4;
+
+				HarnessResult result(frameCount(run));
+				runCluster(run, result);
+				const bool runOk = passed(result, run);
+				ok = ok && runOk;
+				std::printf("%6u %8u %12u %12.0f %12.1f %12.1f %12.1f  %s\n", numNodes, run.numPlayers,
+					run.numCollectibles, double(result.mFrameBytes) / result.mNumFrames,
+					result.mStats.getHistogram(SyncStats::ENCODETIME).getMean(),
+					result.mStats.getHistogram(SyncStats::DECODETIME).getMean(),
+					result.mLatency.getMean(), runOk ? "yes" : "NO");
+			}
+		}
+		return ok;
+	}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	HarnessConfig config;
+	if (!parseArguments(argc, argv, config))
+	{
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	if (!config.verbose)
+		SimLog::setCallback(nullptr);
+
+	if (config.sweep)
+		return printSweep(config) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	HarnessResult result(frameCount(config));
+	runCluster(config, result);
+	printResult(result, config);
+	return passed(result, config) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
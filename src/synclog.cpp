@@ -0,0 +1,173 @@
+#include "synclog.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	//Magic and version, the smallest file header a log can have
+	constexpr size_t MINHEADERBYTES = 2 * sizeof(uint32_t);
+	constexpr size_t RECORDHEADERBYTES = sizeof(uint8_t) + sizeof(double) + sizeof(uint32_t);
+} // namespace
+
+SyncRecorder::~SyncRecorder()
+{
+	close();
+}
+
+bool SyncRecorder::open(const std::string& path, unsigned spawnSeed)
+{
+	close();
+	mFile = std::fopen(path.c_str(), "wb");
+	if (!mFile)
+		return false;
+
+	const uint32_t header[3] = { SyncLog::MAGIC, SyncLog::VERSION, spawnSeed };
+	std::fwrite(header, sizeof(header), 1, mFile);
+	return true;
+}
+
+void SyncRecorder::close()
+{
+	if (mFile)
+	{
+		std::fclose(mFile);
+		mFile = nullptr;
+	}
+}
+
+void SyncRecorder::record(SyncLog::RecordType type, double time, ByteSpan data)
+{
+	if (!mFile)
+		return;
+
+	std::byte header[RECORDHEADERBYTES];
+	ByteWriter writer(header, header + RECORDHEADERBYTES);
+	writer.write(static_cast<uint8_t>(type));
+	writer.write(time);
+	writer.write(static_cast<uint32_t>(data.mSize));
+
+	std::fwrite(header, RECORDHEADERBYTES, 1, mFile);
+	if (data.mSize > 0)
+		std::fwrite(data.mData, data.mSize, 1, mFile);
+}
+
+SyncLogReader::~SyncLogReader()
+{
+	close();
+}
+
+bool SyncLogReader::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+	                    FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE)
+	{
+		mFile = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mFile, &size) || size.QuadPart < static_cast<LONGLONG>(MINHEADERBYTES))
+	{
+		close();
+		return false;
+	}
+	mSize = static_cast<size_t>(size.QuadPart);
+
+	mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mMapping)
+		mData = static_cast<const std::byte*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	mFile = ::open(path.c_str(), O_RDONLY);
+	if (mFile < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(mFile, &info) != 0 || info.st_size < static_cast<off_t>(MINHEADERBYTES))
+	{
+		close();
+		return false;
+	}
+	mSize = static_cast<size_t>(info.st_size);
+
+	void* mapped = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+	if (mapped != MAP_FAILED)
+	{
+		mData = static_cast<const std::byte*>(mapped);
+		//Records are read front to back once
+		madvise(mapped, mSize, MADV_SEQUENTIAL);
+	}
+#endif
+
+	uint32_t magic = 0;
+	ByteReader header(ByteSpan(mData, mData ? mSize : 0), 0);
+	if (!mData || !header.read(magic) || !header.read(mVersion)
+		|| magic != SyncLog::MAGIC || mVersion == 0 || mVersion > SyncLog::VERSION
+		|| (hasSpawnSeed() && !header.read(mSpawnSeed)))
+	{
+		close();
+		return false;
+	}
+	mHeaderBytes = header.getPos();
+
+	rewind();
+	return true;
+}
+
+void SyncLogReader::close()
+{
+#ifdef _WIN32
+	if (mData)
+		UnmapViewOfFile(mData);
+	if (mMapping)
+		CloseHandle(mMapping);
+	if (mFile)
+		CloseHandle(mFile);
+	mMapping = nullptr;
+	mFile = nullptr;
+#else
+	if (mData)
+		munmap(const_cast<std::byte*>(mData), mSize);
+	if (mFile >= 0)
+		::close(mFile);
+	mFile = -1;
+#endif
+	mData = nullptr;
+	mSize = 0;
+	mPos = 0;
+	mVersion = 0;
+	mSpawnSeed = 0;
+	mHeaderBytes = 0;
+}
+
+bool SyncLogReader::next(SyncLog::Record& record)
+{
+	ByteReader input(ByteSpan(mData, mSize), mPos);
+
+	uint8_t type = 0;
+	uint32_t size = 0;
+	if (!(input.read(type) && input.read(record.mTime) && input.read(size))
+		|| size > input.getRemaining() || type > SyncLog::BINARY_MESSAGE)
+		return false;
+
+	record.mType = static_cast<SyncLog::RecordType>(type);
+	record.mData = ByteSpan(mData + input.getPos(), size);
+	mPos = input.getPos() + size;
+	return true;
+}
+
+void SyncLogReader::rewind()
+{
+	mPos = mHeaderBytes;
+}
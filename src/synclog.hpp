@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "bytestream.hpp"
+
+//Recordings of a show: every sync payload master sent and every websocket message it
+//received, in the order they happened, so performance problems can be replayed later
+//
+//File layout, values in host byte order:
+//  uint32 MAGIC, uint32 VERSION, uint32 spawn seed of master
+//  records: uint8 record type, double seconds since the engine started,
+//           uint32 payload size, payload
+//Version 2 added BINARY_MESSAGE, version 3 the spawn seed. Older logs are still read
+namespace SyncLog {
+	constexpr uint32_t MAGIC = 0x474C5344; // "DSLG"
+	constexpr uint32_t VERSION = 3;
+
+	enum RecordType : uint8_t
+	{
+		//What encode() returned
+		FRAME = 0,
+
+		//Message from the websocket server, as messageReceived() got it
+		MESSAGE = 1,
+
+		//Same, when the server picked the binary protocol (see RelayProtocol)
+		BINARY_MESSAGE = 2
+	};
+
+	struct Record
+	{
+		RecordType mType;
+		double mTime;
+
+		//Points into the mapped file, valid as long as the reader
+		ByteSpan mData;
+	};
+} // namespace SyncLog
+
+//Appends records to a log file on master
+//Writes go through the buffer of the C file, so recording does not allocate
+class SyncRecorder
+{
+public:
+	SyncRecorder() = default;
+	~SyncRecorder();
+
+	SyncRecorder(const SyncRecorder&) = delete;
+	SyncRecorder& operator=(const SyncRecorder&) = delete;
+
+	//Start a new log at path, false if it can not be created
+	//spawnSeed is the seed master spawns collectibles with, so a replay can do the same
+	bool open(const std::string& path, unsigned spawnSeed);
+	void close();
+
+	//Does nothing unless a log is open
+	void record(SyncLog::RecordType type, double time, ByteSpan data);
+
+	//Accessors
+	bool isOpen() const { return mFile != nullptr; }
+
+private:
+	std::FILE* mFile = nullptr;
+};
+
+//Reads a log through a memory mapping, records are returned in place without copying
+//so long sessions play back as fast as they can be decoded
+class SyncLogReader
+{
+public:
+	SyncLogReader() = default;
+	~SyncLogReader();
+
+	SyncLogReader(const SyncLogReader&) = delete;
+	SyncLogReader& operator=(const SyncLogReader&) = delete;
+
+	//Map the log at path, false if it can not be mapped or is not a log
+	bool open(const std::string& path);
+	void close();
+
+	//Read the next record, false at the end of the log or at a record cut short,
+	//e.g. by a crash while recording
+	bool next(SyncLog::Record& record);
+
+	//Start over from the first record
+	void rewind();
+
+	//Accessors
+	size_t getSize() const { return mSize; }
+	uint32_t getVersion() const { return mVersion; }
+	//Logs before version 3 have no seed
+	bool hasSpawnSeed() const { return mVersion >= 3; }
+	unsigned getSpawnSeed() const { return mSpawnSeed; }
+
+private:
+	const std::byte* mData = nullptr;
+	size_t mSize = 0;
+	size_t mPos = 0;
+
+	//From the file header, the records start after it
+	uint32_t mVersion = 0;
+	uint32_t mSpawnSeed = 0;
+	size_t mHeaderBytes = 0;
+
+#ifdef _WIN32
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+#else
+	int mFile = -1;
+#endif
+};
@@ -0,0 +1,159 @@
+#include "syncstats.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+RollingHistogram::RollingHistogram(size_t window)
+	: mSamples(std::max<size_t>(window, 1), 0.0)
+{
+}
+
+size_t RollingHistogram::bucketOf(double value)
+{
+	if (!(value >= 1.0))
+		return 0;
+	int exponent = 0;
+	std::frexp(value, &exponent);
+	return std::min<size_t>(static_cast<size_t>(exponent), NUMBUCKETS - 1);
+}
+
+void RollingHistogram::add(double value)
+{
+	//Drop the oldest sample once the window is full
+	if (mNumSamples == mSamples.size())
+	{
+		const double oldest = mSamples[mNext];
+		mSum -= oldest;
+		--mBuckets[bucketOf(oldest)];
+	}
+	else
+		++mNumSamples;
+
+	mSamples[mNext] = value;
+	mNext = (mNext + 1) % mSamples.size();
+	mSum += value;
+	++mBuckets[bucketOf(value)];
+}
+
+void RollingHistogram::clear()
+{
+	mNext = 0;
+	mNumSamples = 0;
+	mSum = 0.0;
+	mBuckets.fill(0);
+}
+
+double RollingHistogram::getMean() const
+{
+	return mNumSamples > 0 ? mSum / mNumSamples : 0.0;
+}
+
+double RollingHistogram::getMax() const
+{
+	//The window is small, scanning it is cheaper than keeping a max up to date
+	double max = 0.0;
+	for (size_t i = 0; i < mNumSamples; ++i)
+		max = std::max(max, mSamples[i]);
+	return max;
+}
+
+double RollingHistogram::getPercentile(double fraction) const
+{
+	const double wanted = fraction * mNumSamples;
+	unsigned counted = 0;
+	for (size_t i = 0; i < NUMBUCKETS; ++i)
+	{
+		counted += mBuckets[i];
+		if (counted >= wanted && counted > 0)
+			return std::ldexp(1.0, static_cast<int>(i));
+	}
+	return 0.0;
+}
+
+SyncStats::SyncStats(size_t window)
+{
+	mHistograms.fill(RollingHistogram(window));
+}
+
+SyncStats::~SyncStats()
+{
+	closeCsv();
+}
+
+void SyncStats::add(const SyncFrameStats& frame)
+{
+	mHistograms[FRAMEBYTES].add(frame.mFrameBytes);
+	mHistograms[METADATABYTES].add(frame.mMetadataBytes);
+	mHistograms[PLAYERBYTES].add(frame.mPlayerBytes);
+	mHistograms[COLLECTIBLEBYTES].add(frame.mCollectibleBytes);
+	mHistograms[ENCODETIME].add(frame.mEncodeTime);
+	mHistograms[DECODETIME].add(frame.mDecodeTime);
+	mHistograms[PLAYERAPPLYTIME].add(frame.mPlayerApplyTime);
+	mHistograms[COLLECTIBLEAPPLYTIME].add(frame.mCollectibleApplyTime);
+
+	if (mCsv)
+	{
+		std::fprintf(mCsv, "%u,%d,%u,%u,%u,%u,%u,%u,%.2f,%.2f,%.2f,%.2f\n",
+			frame.mSequence, frame.mIsKeyframe ? 1 : 0, frame.mFrameBytes, frame.mMetadataBytes,
+			frame.mPlayerBytes, frame.mCollectibleBytes, frame.mPlayerEntries, frame.mCollectibleEntries,
+			frame.mEncodeTime, frame.mDecodeTime, frame.mPlayerApplyTime, frame.mCollectibleApplyTime);
+	}
+}
+
+bool SyncStats::openCsv(const std::string& path)
+{
+	closeCsv();
+	mCsv = std::fopen(path.c_str(), "w");
+	if (!mCsv)
+		return false;
+
+	std::fprintf(mCsv, "sequence,keyframe,frame_bytes,metadata_bytes,player_bytes,collectible_bytes,"
+		"player_entries,collectible_entries,encode_us,decode_us,player_apply_us,collectible_apply_us\n");
+	return true;
+}
+
+void SyncStats::closeCsv()
+{
+	if (mCsv)
+	{
+		std::fclose(mCsv);
+		mCsv = nullptr;
+	}
+}
+
+std::string formatHistogram(const char* name, const RollingHistogram& histogram)
+{
+	char line[128];
+	std::snprintf(line, sizeof(line), "%-22s mean %8.1f  p95 <%8.0f  max %8.1f\n",
+		name, histogram.getMean(), histogram.getPercentile(0.95), histogram.getMax());
+	return line;
+}
+
+std::string SyncStats::getSummary() const
+{
+	std::string summary;
+	for (unsigned metric = 0; metric < NUMMETRICS; ++metric)
+	{
+		const RollingHistogram& histogram = mHistograms[metric];
+		if (histogram.getMax() == 0.0)
+			continue;
+
+		summary += formatHistogram(getMetricName(static_cast<Metric>(metric)), histogram);
+	}
+	return summary;
+}
+
+const char* SyncStats::getMetricName(Metric metric)
+{
+	static const char* names[NUMMETRICS] = {
+		"frame bytes",
+		"metadata bytes",
+		"player bytes",
+		"collectible bytes",
+		"encode us",
+		"decode us",
+		"player apply us",
+		"collectible apply us"
+	};
+	return names[metric];
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//Sizes and timings of one sync frame, split by object type
+//Filled by SyncEncoder on master and SyncDecoder on the render nodes
+struct SyncFrameStats
+{
+	uint32_t mSequence = 0;
+	bool mIsKeyframe = false;
+
+	//Bytes of the whole frame and of each section
+	uint32_t mFrameBytes = 0;
+	uint32_t mMetadataBytes = 0;
+	uint32_t mPlayerBytes = 0;
+	uint32_t mCollectibleBytes = 0;
+
+	//Objects sent in each section
+	uint32_t mPlayerEntries = 0;
+	uint32_t mCollectibleEntries = 0;
+
+	//Microseconds spent encoding the frame on master or decoding it on a node,
+	//the apply times are the part of decoding spent in each section
+	float mEncodeTime = 0.f;
+	float mDecodeTime = 0.f;
+	float mPlayerApplyTime = 0.f;
+	float mCollectibleApplyTime = 0.f;
+};
+
+//Distribution of the last window samples of one value
+//Samples are counted in power of two buckets, so percentiles are upper bounds that
+//are off by at most a factor 2. Adding samples never allocates
+class RollingHistogram
+{
+public:
+	//Bucket 0 counts samples below 1, bucket i samples in [2^(i-1), 2^i)
+	static constexpr size_t NUMBUCKETS = 32;
+
+	explicit RollingHistogram(size_t window = 600);
+
+	void add(double value);
+	void clear();
+
+	//Of the samples in the window
+	double getMean() const;
+	double getMax() const;
+
+	//Upper bound of the bucket below which fraction of the samples are
+	double getPercentile(double fraction) const;
+
+	//Accessors
+	size_t getNumSamples() const { return mNumSamples; }
+	const std::array<unsigned, NUMBUCKETS>& getBuckets() const { return mBuckets; }
+
+private:
+	static size_t bucketOf(double value);
+
+	//Ring buffer of the window, mNext is overwritten next
+	std::vector<double> mSamples;
+	size_t mNext = 0;
+	size_t mNumSamples = 0;
+
+	double mSum = 0.0;
+	std::array<unsigned, NUMBUCKETS> mBuckets{};
+};
+
+//One line with mean, 95th percentile and max of histogram, like SyncStats::getSummary
+std::string formatHistogram(const char* name, const RollingHistogram& histogram);
+
+//Rolling histograms of every SyncFrameStats value, optionally logged to a CSV file
+//with one row per frame
+class SyncStats
+{
+public:
+	enum Metric
+	{
+		FRAMEBYTES,
+		METADATABYTES,
+		PLAYERBYTES,
+		COLLECTIBLEBYTES,
+		ENCODETIME,
+		DECODETIME,
+		PLAYERAPPLYTIME,
+		COLLECTIBLEAPPLYTIME,
+		NUMMETRICS
+	};
+
+	explicit SyncStats(size_t window = 600);
+	~SyncStats();
+
+	SyncStats(const SyncStats&) = delete;
+	SyncStats& operator=(const SyncStats&) = delete;
+
+	//Add the stats of one frame, and a row to the CSV file if one is open
+	void add(const SyncFrameStats& frame);
+
+	//Log every following frame to path, false if the file can not be opened
+	bool openCsv(const std::string& path);
+	void closeCsv();
+
+	//One line per metric with mean, 95th percentile and max over the window
+	//Metrics that stayed 0, like decode times on master, are left out
+	std::string getSummary() const;
+
+	//Accessors
+	const RollingHistogram& getHistogram(Metric metric) const { return mHistograms[metric]; }
+	static const char* getMetricName(Metric metric);
+
+private:
+	std::array<RollingHistogram, NUMMETRICS> mHistograms;
+	std::FILE* mCsv = nullptr;
+};
@@ -0,0 +1,808 @@
+#include "syncstream.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <initializer_list>
+#include <type_traits>
+
+#include <glm/gtc/constants.hpp>
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	float microsecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<float, std::micro>(Clock::now() - start).count();
+	}
+
+	//Structs are written field by field so padding and unused name bytes are never sent
+	void writePlayerData(ByteWriter& output, const PlayerData& player)
+	{
+		output.write(player.mPoints);
+		output.write(player.mIsAlive);
+		output.write(player.mSpeed);
+	}
+
+	bool readPlayerData(ByteReader& input, PlayerData& player)
+	{
+		return input.read(player.mPoints) && input.read(player.mIsAlive) && input.read(player.mSpeed);
+	}
+
+	bool operator==(const PlayerData& a, const PlayerData& b)
+	{
+		return a.mPoints == b.mPoints && a.mIsAlive == b.mIsAlive && a.mSpeed == b.mSpeed;
+	}
+
+	void writeMetadata(ByteWriter& output, const PlayerMetadata& metadata)
+	{
+		const uint8_t nameLength = static_cast<uint8_t>(std::min(metadata.mNameLength, NAMELIMIT));
+		output.write(metadata.mVersion);
+		output.write(metadata.mEnabled);
+		output.write(nameLength);
+		output.writeBytes(metadata.mPlayerName, nameLength);
+
+		const auto& col = metadata.mPlayerColours;
+		for (float channel : { col.mR1, col.mG1, col.mB1, col.mR2, col.mG2, col.mB2 })
+			output.write(channel);
+	}
+
+	bool readMetadata(ByteReader& input, PlayerMetadata& metadata)
+	{
+		uint8_t nameLength = 0;
+		if (!(input.read(metadata.mVersion) && input.read(metadata.mEnabled) && input.read(nameLength)))
+			return false;
+
+		if (nameLength > NAMELIMIT || !input.readBytes(metadata.mPlayerName, nameLength))
+			return false;
+		metadata.mNameLength = nameLength;
+
+		auto& col = metadata.mPlayerColours;
+		return input.read(col.mR1) && input.read(col.mG1) && input.read(col.mB1)
+			&& input.read(col.mR2) && input.read(col.mG2) && input.read(col.mB2);
+	}
+
+	glm::quat positionQuat(const PositionData& position)
+	{
+		return glm::quat(position.mW, position.mX, position.mY, position.mZ);
+	}
+
+	//Packed quaternion, lowest byte first
+	void writePackedQuat(ByteWriter& output, uint64_t packed)
+	{
+		for (size_t i = 0; i < SyncStream::PACKEDQUATBYTES; ++i)
+			output.write(static_cast<uint8_t>(packed >> (8 * i)));
+	}
+
+	bool readPackedQuat(ByteReader& input, uint64_t& packed)
+	{
+		packed = 0;
+		for (size_t i = 0; i < SyncStream::PACKEDQUATBYTES; ++i)
+		{
+			uint8_t byte = 0;
+			if (!input.read(byte))
+				return false;
+			packed |= uint64_t(byte) << (8 * i);
+		}
+		return true;
+	}
+
+	//Only the position parts set in mask are written
+	void writePositionData(ByteWriter& output, const PositionData& position, uint8_t mask)
+	{
+		if (mask & SyncStream::POSITION)
+			writePackedQuat(output, SyncStream::packQuat(positionQuat(position)));
+		if (mask & SyncStream::ORIENTATION)
+			output.write(SyncStream::packAngle(position.mOrientation));
+		if (mask & SyncStream::SHAPE)
+		{
+			output.write(position.mRadius);
+			output.write(position.mScale);
+		}
+	}
+
+	bool readPositionData(ByteReader& input, PositionData& position, uint8_t mask)
+	{
+		if (mask & SyncStream::POSITION)
+		{
+			uint64_t packed = 0;
+			if (!readPackedQuat(input, packed))
+				return false;
+			const glm::quat q = SyncStream::unpackQuat(packed);
+			position.mW = q.w;
+			position.mX = q.x;
+			position.mY = q.y;
+			position.mZ = q.z;
+		}
+		if (mask & SyncStream::ORIENTATION)
+		{
+			uint16_t packed = 0;
+			if (!input.read(packed))
+				return false;
+			position.mOrientation = SyncStream::unpackAngle(packed);
+		}
+		if (mask & SyncStream::SHAPE)
+			return input.read(position.mRadius) && input.read(position.mScale);
+		return true;
+	}
+
+	void writeCollectibleData(ByteWriter& output, const CollectibleData& collectible)
+	{
+		output.write(collectible.mModelIndex);
+		output.write(collectible.mSpawnTime);
+		output.write(collectible.mSeed);
+	}
+
+	bool readCollectibleData(ByteReader& input, CollectibleData& collectible)
+	{
+		return input.read(collectible.mModelIndex) && input.read(collectible.mSpawnTime)
+			&& input.read(collectible.mSeed);
+	}
+
+	bool operator==(const CollectibleData& a, const CollectibleData& b)
+	{
+		return a.mModelIndex == b.mModelIndex && a.mSpawnTime == b.mSpawnTime && a.mSeed == b.mSeed;
+	}
+
+	//Position parts that differ between a and b
+	//Changes smaller than the packed precision are not worth a frame
+	uint8_t positionChangeMask(const PositionData& a, const PositionData& b)
+	{
+		uint8_t mask = 0;
+		if (SyncStream::packQuat(positionQuat(a)) != SyncStream::packQuat(positionQuat(b)))
+			mask |= SyncStream::POSITION;
+		if (SyncStream::packAngle(a.mOrientation) != SyncStream::packAngle(b.mOrientation))
+			mask |= SyncStream::ORIENTATION;
+		if (a.mRadius != b.mRadius || a.mScale != b.mScale)
+			mask |= SyncStream::SHAPE;
+		return mask;
+	}
+
+	void writeObjectData(ByteWriter& output, const PlayerData& player)
+	{
+		writePlayerData(output, player);
+	}
+
+	void writeObjectData(ByteWriter& output, const CollectibleData& collectible)
+	{
+		writeCollectibleData(output, collectible);
+	}
+
+	//Write the parts of an object set in mask
+	template<typename ObjectData>
+	void writeEntry(ByteWriter& output, size_t slot, uint8_t mask,
+	                const ObjectData& objectData, const PositionData& position)
+	{
+		output.write(static_cast<uint32_t>(slot));
+		output.write(mask);
+		if (mask & SyncStream::OBJECTDATA)
+			writeObjectData(output, objectData);
+		writePositionData(output, position, mask);
+	}
+
+	//Upper bounds of the parts of a frame, see the layout in syncstream.hpp
+	constexpr size_t FRAMEHEADERBYTES = sizeof(uint8_t) + 2 * sizeof(uint32_t);
+	constexpr size_t SECTIONHEADERBYTES = 2 * sizeof(uint32_t);
+	constexpr size_t ENTRYHEADERBYTES = sizeof(uint32_t) + sizeof(uint8_t);
+	constexpr size_t PLAYERDATABYTES = sizeof(int) + sizeof(bool) + sizeof(float);
+	constexpr size_t MOTIONBYTES = sizeof(float);
+	constexpr size_t MAXMETADATABYTES = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(bool)
+		+ sizeof(uint8_t) + NAMELIMIT + 6 * sizeof(float);
+	constexpr size_t COLLECTIBLEDATABYTES = sizeof(int) + sizeof(float) + sizeof(unsigned);
+	constexpr size_t MAXPOSITIONBYTES = SyncStream::PACKEDQUATBYTES + sizeof(uint16_t) + 2 * sizeof(float);
+	constexpr size_t COLLECTEVENTBYTES = sizeof(uint8_t) + sizeof(uint32_t);
+	constexpr size_t MAXCOLLECTEVENTBYTES = COLLECTEVENTBYTES + sizeof(uint8_t) + sizeof(float) + sizeof(unsigned);
+
+	//Spawn events send the model index in a byte, there are far fewer models
+	void writeSpawnedData(ByteWriter& output, const CollectibleData& collectible)
+	{
+		output.write(static_cast<uint8_t>(collectible.mModelIndex));
+		output.write(collectible.mSpawnTime);
+		output.write(collectible.mSeed);
+	}
+
+	bool readSpawnedData(ByteReader& input, CollectibleData& collectible)
+	{
+		uint8_t modelIndex = 0;
+		if (!(input.read(modelIndex) && input.read(collectible.mSpawnTime) && input.read(collectible.mSeed)))
+			return false;
+		collectible.mModelIndex = modelIndex;
+		return true;
+	}
+
+	//Read the counts of a section, rejects counts the rest of data can not hold so a
+	//corrupt frame never makes the pools grow
+	bool readSectionHeader(ByteReader& input, uint32_t& numObjects, uint32_t& numEntries)
+	{
+		return input.read(numObjects) && input.read(numEntries) && numEntries <= numObjects
+			&& numEntries <= input.getRemaining() / ENTRYHEADERBYTES;
+	}
+
+	//Copy the position parts set in mask from current into sent
+	//Parts left out keep the value the nodes have
+	void storeSentPosition(PositionData& sent, const PositionData& current, uint8_t mask)
+	{
+		if (mask & SyncStream::POSITION)
+		{
+			sent.mW = current.mW;
+			sent.mX = current.mX;
+			sent.mY = current.mY;
+			sent.mZ = current.mZ;
+		}
+		if (mask & SyncStream::ORIENTATION)
+			sent.mOrientation = current.mOrientation;
+		if (mask & SyncStream::SHAPE)
+		{
+			sent.mRadius = current.mRadius;
+			sent.mScale = current.mScale;
+		}
+	}
+} // namespace
+
+uint64_t SyncStream::packQuat(const glm::quat& q)
+{
+	//q and -q are the same rotation, flip so the largest component is positive and
+	//leave it out, it follows from the other three since q has unit length
+	const float components[4] = { q.x, q.y, q.z, q.w };
+	unsigned largest = 0;
+	for (unsigned i = 1; i < 4; ++i)
+	{
+		if (std::abs(components[i]) > std::abs(components[largest]))
+			largest = i;
+	}
+	const float sign = components[largest] < 0.f ? -1.f : 1.f;
+
+	//The three smaller components are within +-1/sqrt(2)
+	constexpr float range = 0.70710678f;
+	constexpr float maxValue = (1u << QUATBITS) - 1;
+
+	uint64_t packed = largest;
+	unsigned shift = 2;
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+		const float normalized = glm::clamp((sign * components[i] + range) / (2.f * range), 0.f, 1.f);
+		packed |= uint64_t(std::lround(normalized * maxValue)) << shift;
+		shift += QUATBITS;
+	}
+	return packed;
+}
+
+glm::quat SyncStream::unpackQuat(uint64_t packed)
+{
+	constexpr float range = 0.70710678f;
+	constexpr float maxValue = (1u << QUATBITS) - 1;
+	constexpr uint64_t componentMask = (1u << QUATBITS) - 1;
+
+	const unsigned largest = packed & 3;
+	float components[4];
+	float sumSquares = 0.f;
+	unsigned shift = 2;
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+		const float normalized = ((packed >> shift) & componentMask) / maxValue;
+		components[i] = normalized * 2.f * range - range;
+		sumSquares += components[i] * components[i];
+		shift += QUATBITS;
+	}
+	components[largest] = std::sqrt(std::max(0.f, 1.f - sumSquares));
+
+	return glm::normalize(glm::quat(components[3], components[0], components[1], components[2]));
+}
+
+uint16_t SyncStream::packAngle(float radians)
+{
+	const float turns = radians / glm::two_pi<float>();
+	return static_cast<uint16_t>(std::lround((turns - std::floor(turns)) * 65536.f) & 0xFFFF);
+}
+
+float SyncStream::unpackAngle(uint16_t packed)
+{
+	return packed / 65536.f * glm::two_pi<float>();
+}
+
+void GameFrameHeader::write(std::vector<std::byte>& output) const
+{
+	const size_t begin = output.size();
+	output.resize(begin + BYTES);
+
+	ByteWriter writer(output.data() + begin, output.data() + output.size());
+	writer.write(mIsGameEnded);
+	writer.write(mAreStatsVisible);
+	writer.write(mIsGameStarted);
+	writer.write(mRenderTime);
+}
+
+bool GameFrameHeader::read(ByteReader& input)
+{
+	return input.read(mIsGameEnded) && input.read(mAreStatsVisible) && input.read(mIsGameStarted)
+		&& input.read(mRenderTime);
+}
+
+void SyncEncoder::setKeyframeInterval(unsigned frames)
+{
+	mKeyframeInterval = std::max(1u, frames);
+}
+
+void SyncEncoder::setPlayerSyncInterval(unsigned frames)
+{
+	mPlayerSyncInterval = std::max(1u, frames);
+}
+
+size_t SyncEncoder::maxFrameBytes(size_t numPlayers, size_t numCollectibles, size_t numCollectEvents)
+{
+	return FRAMEHEADERBYTES + sizeof(uint32_t) + 2 * SECTIONHEADERBYTES + sizeof(uint8_t)
+		+ sizeof(uint32_t) + numCollectEvents * MAXCOLLECTEVENTBYTES
+		+ numPlayers * (MAXMETADATABYTES + ENTRYHEADERBYTES + PLAYERDATABYTES + MAXPOSITIONBYTES + MOTIONBYTES)
+		+ numCollectibles * (ENTRYHEADERBYTES + COLLECTIBLEDATABYTES + MAXPOSITIONBYTES);
+}
+
+size_t SyncEncoder::getReserveBytes(const Simulation& simulation) const
+{
+	const size_t numCollectEvents = mCollectibleEvents ? simulation.getCollectPool().getEvents().size() : 0;
+	return maxFrameBytes(std::max(simulation.getPlayers().size(), simulation.getMaxPlayers()),
+		std::max(simulation.getCollectPool().getNumEnabled(), simulation.getMaxCollectibles()),
+		numCollectEvents);
+}
+
+void SyncEncoder::encode(const Simulation& simulation, std::vector<std::byte>& output)
+{
+	ZoneScoped;
+	const Clock::time_point start = Clock::now();
+
+	const size_t numPlayers = simulation.getPlayers().size();
+	const size_t numCollectibles = simulation.getCollectPool().getNumEnabled();
+	const size_t numCollectEvents = mCollectibleEvents ? simulation.getCollectPool().getEvents().size() : 0;
+
+	//Size buffers for the counts the simulation was set up for on the first frame, so
+	//they are only grown again if those are exceeded
+	const size_t expectedPlayers = std::max(numPlayers, simulation.getMaxPlayers());
+	const size_t expectedCollectibles = std::max(numCollectibles, simulation.getMaxCollectibles());
+	mPlayers.reserve(expectedPlayers);
+	mCollectibles.reserve(expectedCollectibles);
+
+	//Serialize in place into the largest frame the counts allow, then cut to size
+	const size_t begin = output.size();
+	output.reserve(begin + getReserveBytes(simulation));
+	output.resize(begin + maxFrameBytes(numPlayers, numCollectibles, numCollectEvents));
+
+	ByteWriter writer(output.data() + begin, output.data() + output.size());
+	encodeFrame(simulation, writer);
+	output.resize(writer.getCursor() - output.data());
+
+	mFrameStats.mFrameBytes = static_cast<uint32_t>(output.size() - begin);
+	mFrameStats.mEncodeTime = microsecondsSince(start);
+}
+
+void SyncEncoder::encodeFrame(const Simulation& simulation, ByteWriter& output)
+{
+	const bool isKeyframe = mForceKeyframe || mSequence % mKeyframeInterval == 0;
+	const bool syncMotion = isKeyframe || mSequence % mPlayerSyncInterval == 0;
+	mForceKeyframe = false;
+	mLastWasKeyframe = isKeyframe;
+
+	mFrameStats = SyncFrameStats{};
+	mFrameStats.mSequence = mSequence;
+	mFrameStats.mIsKeyframe = isKeyframe;
+
+	output.write(static_cast<uint8_t>(isKeyframe ? SyncStream::KEYFRAME : SyncStream::DELTA));
+	output.write(mSequence++);
+	std::byte* frameSizeAt = output.skip<uint32_t>();
+
+	const std::byte* metadataBegin = output.getCursor();
+	encodeMetadata(simulation, isKeyframe, output);
+	const std::byte* playersBegin = output.getCursor();
+	encodePlayers(simulation, isKeyframe, syncMotion, output);
+	const std::byte* collectiblesBegin = output.getCursor();
+	encodeCollectibles(simulation, isKeyframe, output);
+
+	mFrameStats.mMetadataBytes = static_cast<uint32_t>(playersBegin - metadataBegin);
+	mFrameStats.mPlayerBytes = static_cast<uint32_t>(collectiblesBegin - playersBegin);
+	mFrameStats.mCollectibleBytes = static_cast<uint32_t>(output.getCursor() - collectiblesBegin);
+
+	const std::byte* sectionsBegin = frameSizeAt + sizeof(uint32_t);
+	ByteWriter::writeAt(frameSizeAt, static_cast<uint32_t>(output.getCursor() - sectionsBegin));
+}
+
+void SyncEncoder::encodeMetadata(const Simulation& simulation, bool isKeyframe, ByteWriter& output)
+{
+	const std::vector<Player>& players = simulation.getPlayers();
+	std::byte* numEntriesAt = output.skip<uint32_t>();
+
+	//Versions are compared so names are only copied for players that changed or joined,
+	//the sent versions are stored with the rest of the player in encodePlayers
+	uint32_t numEntries = 0;
+	for (size_t i = 0; i < players.size(); ++i)
+	{
+		if (isKeyframe || i >= mPlayers.size() || players[i].getMetadataVersion() != mPlayers[i].mMetadataVersion)
+		{
+			output.write(static_cast<uint32_t>(i));
+			writeMetadata(output, players[i].getMetadata());
+			++numEntries;
+		}
+	}
+	ByteWriter::writeAt(numEntriesAt, numEntries);
+}
+
+void SyncEncoder::encodePlayers(const Simulation& simulation, bool isKeyframe, bool syncMotion,
+                                ByteWriter& output)
+{
+	//Clients receive the same interpolated state master renders
+	const std::vector<Player>& players = simulation.getPlayers();
+	const float alpha = simulation.getRenderAlpha();
+
+	output.write(static_cast<uint32_t>(players.size()));
+	std::byte* numEntriesAt = output.skip<uint32_t>();
+
+	uint32_t numEntries = 0;
+	for (size_t i = 0; i < players.size(); ++i)
+	{
+		const SyncStream::PlayerState current{ players[i].getPlayerData(),
+		                                       players[i].getInterpolatedPositionData(alpha),
+		                                       players[i].getTurnSpeed(),
+		                                       players[i].getMetadataVersion() };
+
+		//Slots the nodes have not seen yet are always sent in full
+		uint8_t mask = SyncStream::ALLPLAYERPARTS;
+		if (!isKeyframe && i < mPlayers.size())
+		{
+			const SyncStream::PlayerState& sent = mPlayers[i];
+			mask = 0;
+			if (syncMotion)
+			{
+				mask = positionChangeMask(current.mPositionData, sent.mPositionData);
+				if (current.mTurnSpeed != sent.mTurnSpeed)
+					mask |= SyncStream::MOTION;
+			}
+			if (!(current.mPlayerData == sent.mPlayerData))
+				mask |= SyncStream::OBJECTDATA;
+		}
+
+		if (mask != 0)
+		{
+			writeEntry(output, i, mask, current.mPlayerData, current.mPositionData);
+			if (mask & SyncStream::MOTION)
+				output.write(current.mTurnSpeed);
+			++numEntries;
+		}
+
+		if (i < mPlayers.size())
+		{
+			SyncStream::PlayerState& sent = mPlayers[i];
+			sent.mPlayerData = current.mPlayerData;
+			storeSentPosition(sent.mPositionData, current.mPositionData, mask);
+			sent.mMetadataVersion = current.mMetadataVersion;
+			if (mask & SyncStream::MOTION)
+				sent.mTurnSpeed = current.mTurnSpeed;
+		}
+		else
+			mPlayers.push_back(current);
+	}
+	ByteWriter::writeAt(numEntriesAt, numEntries);
+	mFrameStats.mPlayerEntries = numEntries;
+	mPlayers.resize(players.size());
+}
+
+void SyncEncoder::encodeCollectibles(const Simulation& simulation, bool isKeyframe,
+                                     ByteWriter& output)
+{
+	if (mCollectibleEvents && !isKeyframe)
+	{
+		encodeCollectEvents(simulation, output);
+		return;
+	}
+
+	const CollectiblePool& pool = simulation.getCollectPool();
+	const size_t numEnabled = pool.getNumEnabled();
+
+	output.write(SyncStream::STATES);
+	output.write(static_cast<uint32_t>(numEnabled));
+	std::byte* numEntriesAt = output.skip<uint32_t>();
+
+	uint32_t numEntries = 0;
+	for (size_t i = 0; i < numEnabled; ++i)
+	{
+		const SyncStream::CollectibleState current{ pool.getCollectibleData(i), pool.getPositionData(i) };
+
+		uint8_t mask = SyncStream::ALLPARTS;
+		if (!isKeyframe && i < mCollectibles.size())
+		{
+			mask = positionChangeMask(current.mPositionData, mCollectibles[i].mPositionData);
+			if (!(current.mCollectData == mCollectibles[i].mCollectData))
+				mask |= SyncStream::OBJECTDATA;
+		}
+
+		if (mask != 0)
+		{
+			writeEntry(output, i, mask, current.mCollectData, current.mPositionData);
+			++numEntries;
+		}
+
+		if (i < mCollectibles.size())
+		{
+			mCollectibles[i].mCollectData = current.mCollectData;
+			storeSentPosition(mCollectibles[i].mPositionData, current.mPositionData, mask);
+		}
+		else
+			mCollectibles.push_back(current);
+	}
+	ByteWriter::writeAt(numEntriesAt, numEntries);
+	mFrameStats.mCollectibleEntries = numEntries;
+	mCollectibles.resize(numEnabled);
+}
+
+void SyncEncoder::encodeCollectEvents(const Simulation& simulation, ByteWriter& output)
+{
+	const CollectiblePool& pool = simulation.getCollectPool();
+	const std::vector<CollectiblePool::Event>& events = pool.getEvents();
+
+	output.write(SyncStream::EVENTS);
+	output.write(static_cast<uint32_t>(simulation.getSpawnSeed()));
+	output.write(static_cast<uint32_t>(pool.getNumEnabled()));
+	output.write(static_cast<uint32_t>(events.size()));
+	for (const CollectiblePool::Event& event : events)
+	{
+		output.write(static_cast<uint8_t>(event.mType));
+		output.write(static_cast<uint32_t>(event.mSlot));
+		if (event.mType == CollectiblePool::Event::SPAWN)
+			writeSpawnedData(output, event.mData);
+	}
+	mFrameStats.mCollectibleEntries = static_cast<uint32_t>(events.size());
+}
+
+bool SyncDecoder::decode(const std::vector<std::byte>& data, unsigned int& pos, Simulation& simulation)
+{
+	size_t spanPos = pos;
+	const bool applied = decode(ByteSpan(data), spanPos, simulation);
+	pos = static_cast<unsigned int>(spanPos);
+	return applied;
+}
+
+bool SyncDecoder::decode(ByteSpan data, size_t& pos, Simulation& simulation)
+{
+	ZoneScoped;
+	const Clock::time_point start = Clock::now();
+
+	ByteReader input(data, pos);
+	mFrameStats = SyncFrameStats{};
+	const bool applied = decodeFrame(input, simulation);
+	mFrameStats.mFrameBytes = static_cast<uint32_t>(input.getPos() - pos);
+	pos = input.getPos();
+	mFrameStats.mDecodeTime = microsecondsSince(start);
+	return applied;
+}
+
+bool SyncDecoder::decodeFrame(ByteReader& input, Simulation& simulation)
+{
+	uint8_t frameType = 0;
+	uint32_t sequence = 0, frameSize = 0;
+	if (!(input.read(frameType) && input.read(sequence) && input.read(frameSize))
+		|| frameSize > input.getRemaining())
+	{
+		mHasKeyframe = false;
+		input.setPos(input.getPos() + input.getRemaining());
+		return false;
+	}
+	const size_t frameEnd = input.getPos() + frameSize;
+
+	const bool isKeyframe = frameType == SyncStream::KEYFRAME;
+	mFrameStats.mSequence = sequence;
+	mFrameStats.mIsKeyframe = isKeyframe;
+	if (!isKeyframe && (!mHasKeyframe || sequence != mLastSequence + 1))
+	{
+		//Missed a frame, the delta does not apply to what this node has
+		mHasKeyframe = false;
+		++mNumSkippedFrames;
+		input.setPos(frameEnd);
+		return false;
+	}
+
+	//Sections are timed one by one, the apply times of the frame stats
+	const size_t metadataBegin = input.getPos();
+	bool isValid = decodeMetadata(input, simulation);
+
+	const size_t playersBegin = input.getPos();
+	Clock::time_point start = Clock::now();
+	isValid = isValid && decodePlayers(input, simulation, isKeyframe);
+	mFrameStats.mPlayerApplyTime = microsecondsSince(start);
+
+	const size_t collectiblesBegin = input.getPos();
+	start = Clock::now();
+	isValid = isValid && decodeCollectibles(input, simulation, isKeyframe);
+	mFrameStats.mCollectibleApplyTime = microsecondsSince(start);
+
+	mFrameStats.mMetadataBytes = static_cast<uint32_t>(playersBegin - metadataBegin);
+	mFrameStats.mPlayerBytes = static_cast<uint32_t>(collectiblesBegin - playersBegin);
+	mFrameStats.mCollectibleBytes = static_cast<uint32_t>(input.getPos() - collectiblesBegin);
+
+	if (!isValid || input.getPos() != frameEnd)
+	{
+		mHasKeyframe = false;
+		++mNumSkippedFrames;
+		input.setPos(frameEnd);
+		return false;
+	}
+
+	mHasKeyframe = true;
+	mLastSequence = sequence;
+	return true;
+}
+
+bool SyncDecoder::decodeMetadata(ByteReader& input, Simulation& simulation)
+{
+	constexpr size_t minEntryBytes = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(bool) + sizeof(uint8_t);
+	uint32_t numEntries = 0;
+	if (!input.read(numEntries) || numEntries > input.getRemaining() / minEntryBytes)
+		return false;
+
+	for (uint32_t entry = 0; entry < numEntries; ++entry)
+	{
+		uint32_t id = 0;
+		PlayerMetadata metadata{};
+		if (!input.read(id) || !readMetadata(input, metadata) || metadata.mVersion == 0)
+			return false;
+
+		//Ids are player slots, a joining player is at most one past the known ones
+		if (id > std::max(mMetadata.size(), simulation.getPlayers().size()))
+			return false;
+		if (id >= mMetadata.size())
+			mMetadata.resize(id + 1, PlayerMetadata{});
+
+		//Metadata resent in keyframes is only applied if the version differs
+		if (metadata.mVersion == mMetadata[id].mVersion)
+			continue;
+		mMetadata[id] = metadata;
+		if (id < simulation.getPlayers().size())
+			simulation.getSyncedPlayer(id).setMetadata(metadata);
+	}
+	return true;
+}
+
+bool SyncDecoder::decodePlayers(ByteReader& input, Simulation& simulation, bool isKeyframe)
+{
+	uint32_t numObjects = 0, numEntries = 0;
+	if (!readSectionHeader(input, numObjects, numEntries))
+		return false;
+	mFrameStats.mPlayerEntries = numEntries;
+
+	//Every slot this node has no state for has to be sent in full
+	const size_t numKnown = isKeyframe ? 0 : std::min<size_t>(simulation.getPlayers().size(), numObjects);
+	size_t numNew = numObjects - numKnown;
+	if (numNew > numEntries)
+		return false;
+
+	for (uint32_t entry = 0; entry < numEntries; ++entry)
+	{
+		uint32_t slot = 0;
+		uint8_t mask = 0;
+		if (!input.read(slot) || !input.read(mask) || slot >= numObjects)
+			return false;
+
+		const size_t numPlayers = simulation.getPlayers().size();
+		if (slot < numPlayers)
+		{
+			//Parts not in the frame keep their value
+			Player& player = simulation.getSyncedPlayer(slot);
+			PlayerData playerData = player.getPlayerData();
+			PositionData position = player.getPositionData();
+			if ((mask & SyncStream::OBJECTDATA) && !readPlayerData(input, playerData))
+				return false;
+			float turnSpeed = player.getTurnSpeed();
+			if (!readPositionData(input, position, mask)
+				|| ((mask & SyncStream::MOTION) && !input.read(turnSpeed)))
+				return false;
+			player.setPlayerData(playerData, position);
+			player.setTurnSpeed(turnSpeed);
+		}
+		else if (slot == numPlayers && mask == SyncStream::ALLPLAYERPARTS)
+		{
+			//New players are sent in slot order, their metadata comes first
+			PlayerData playerData{};
+			PositionData position{};
+			float turnSpeed = 0.f;
+			if (slot >= mMetadata.size() || mMetadata[slot].mVersion == 0
+				|| !readPlayerData(input, playerData) || !readPositionData(input, position, mask)
+				|| !input.read(turnSpeed))
+				return false;
+			simulation.addPlayer(mMetadata[slot], position);
+
+			//The constructor only takes metadata and position, set the rest like any update
+			Player& player = simulation.getSyncedPlayer(slot);
+			player.setPlayerData(playerData, position);
+			player.setTurnSpeed(turnSpeed);
+		}
+		else
+			return false;
+
+		if (slot >= numKnown && mask == SyncStream::ALLPLAYERPARTS)
+			--numNew;
+	}
+	return numNew == 0;
+}
+
+bool SyncDecoder::decodeCollectibles(ByteReader& input, Simulation& simulation, bool isKeyframe)
+{
+	uint8_t sectionType = 0;
+	if (!input.read(sectionType))
+		return false;
+	if (sectionType == SyncStream::EVENTS && !isKeyframe)
+		return decodeCollectEvents(input, simulation);
+	if (sectionType != SyncStream::STATES)
+		return false;
+
+	uint32_t numObjects = 0, numEntries = 0;
+	if (!readSectionHeader(input, numObjects, numEntries))
+		return false;
+	mFrameStats.mCollectibleEntries = numEntries;
+
+	CollectiblePool& pool = simulation.getSyncedCollectPool();
+	const size_t numKnown = isKeyframe ? 0 : std::min<size_t>(pool.getNumEnabled(), numObjects);
+	size_t numNew = numObjects - numKnown;
+	if (numNew > numEntries)
+		return false;
+	pool.setNumEnabled(numObjects);
+
+	for (uint32_t entry = 0; entry < numEntries; ++entry)
+	{
+		uint32_t slot = 0;
+		uint8_t mask = 0;
+		if (!input.read(slot) || !input.read(mask) || slot >= numObjects)
+			return false;
+
+		CollectibleData collectData = pool.getCollectibleData(slot);
+		PositionData position = pool.getPositionData(slot);
+		if ((mask & SyncStream::OBJECTDATA) && !readCollectibleData(input, collectData))
+			return false;
+		if (!readPositionData(input, position, mask))
+			return false;
+		pool.setCollectibleData(slot, position, collectData);
+
+		if (slot >= numKnown && mask == SyncStream::ALLPARTS)
+			--numNew;
+	}
+	return numNew == 0;
+}
+
+bool SyncDecoder::decodeCollectEvents(ByteReader& input, Simulation& simulation)
+{
+	uint32_t spawnSeed = 0, numObjects = 0, numEvents = 0;
+	if (!(input.read(spawnSeed) && input.read(numObjects) && input.read(numEvents))
+		|| numEvents > input.getRemaining() / COLLECTEVENTBYTES)
+		return false;
+	mFrameStats.mCollectibleEntries = numEvents;
+
+	//Replay the slot changes of master in order, so every slot ends up where it is there
+	CollectiblePool& pool = simulation.getSyncedCollectPool();
+	for (uint32_t i = 0; i < numEvents; ++i)
+	{
+		uint8_t type = 0;
+		uint32_t slot = 0;
+		if (!input.read(type) || !input.read(slot))
+			return false;
+
+		if (type == CollectiblePool::Event::SPAWN)
+		{
+			//Spawns always take the first free slot
+			CollectibleData collectData{};
+			if (slot != pool.getNumEnabled() || !readSpawnedData(input, collectData))
+				return false;
+
+			const glm::quat q = Simulation::getCollectiblePosition(spawnSeed, collectData.mSeed);
+			PositionData position{};
+			position.mW = q.w;
+			position.mX = q.x;
+			position.mY = q.y;
+			position.mZ = q.z;
+			pool.setNumEnabled(slot + 1);
+			pool.setCollectibleData(slot, position, collectData);
+		}
+		else if (type == CollectiblePool::Event::COLLECT && slot < pool.getNumEnabled())
+			pool.disableCollectibleAndSwap(slot);
+		else
+			return false;
+	}
+	return pool.getNumEnabled() == numObjects;
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include "simulation.hpp"
+#include "bytestream.hpp"
+#include "syncstats.hpp"
+
+//Frames of game object state sent from master to the render nodes
+//A keyframe holds every player and collectible, a delta frame only the objects that
+//changed since the previous frame. sgct hands every frame to every node in order, so
+//the previous frame is always the one the nodes last applied. Keyframes are sent
+//every few frames so a node that missed or rejected a frame catches up again
+//
+//Frame layout, values in host byte order like the rest of the sgct sync data:
+//  uint8  frame type (KEYFRAME or DELTA)
+//  uint32 frame sequence, one more than the previous frame
+//  uint32 number of bytes in the sections that follow
+//  metadata section:
+//    uint32 number of entries that follow (every player in a keyframe)
+//    entries: uint32 player id, PlayerMetadata
+//  players section, a packed array:
+//    uint32 number of objects
+//    uint32 number of entries that follow (all objects in a keyframe)
+//    entries: uint32 slot, uint8 change mask, changed parts in mask bit order
+//  collectibles section:
+//    uint8 section type (STATES or EVENTS)
+//    STATES, a packed array like the players section
+//    EVENTS, only in delta frames:
+//      uint32 spawn seed of master, uint32 number of collectibles after the events
+//      uint32 number of events that follow
+//      events: uint8 event type, uint32 slot, for spawns uint8 model index, float
+//      spawn time and uint32 seed
+//Player entries carry PlayerData, collectible entries CollectibleData, so neither
+//pays for the fields of the other
+//
+//Collectibles only move when they spawn or are collected. With collectible events
+//(see SyncEncoder::setCollectibleEvents) delta frames carry the spawns and collects
+//since the previous frame instead, in the order master applied them, and nodes place
+//spawned collectibles with Simulation::getCollectiblePosition
+//
+//Names, colours and enabled state are PlayerMetadata, sent when a player joins, when
+//its version changes and in every keyframe. The player id is the slot of the player,
+//and a node only applies metadata newer than what it has, so the per frame player
+//entries are down to position, orientation, score, speed and turn speed
+//
+//Player positions may be sent less often than every frame, render nodes extrapolate
+//them in between with the synced speed and turn speed (see Player::extrapolate)
+//
+//Positions are packed: the position quaternion as its three smallest components
+//(see packQuat), the orientation in 16 bits and radius and scale, which hardly ever
+//change, only when they do
+namespace SyncStream {
+	enum FrameType : uint8_t
+	{
+		KEYFRAME = 0,
+		DELTA = 1
+	};
+
+	enum CollectibleSection : uint8_t
+	{
+		STATES = 0,
+		EVENTS = 1
+	};
+
+	//Bits of the change mask of an entry
+	enum ChangeBits : uint8_t
+	{
+		//PlayerData or CollectibleData
+		OBJECTDATA = 1 << 0,
+
+		//Parts of PositionData
+		POSITION = 1 << 1,
+		ORIENTATION = 1 << 2,
+		SHAPE = 1 << 3,
+
+		ALLPARTS = OBJECTDATA | POSITION | ORIENTATION | SHAPE,
+
+		//Turn speed of a player, render nodes extrapolate with it
+		MOTION = 1 << 4,
+
+		ALLPLAYERPARTS = ALLPARTS | MOTION
+	};
+
+	//Bits per packed quaternion component and bytes per packed quaternion,
+	//2 bits select the left out component
+	constexpr unsigned QUATBITS = 12;
+	constexpr size_t PACKEDQUATBYTES = (2 + 3 * QUATBITS + 7) / 8;
+
+	//Smallest three encoding of a unit quaternion, the result may be -q
+	//Components are off by at most 0.71 / 2^QUATBITS
+	uint64_t packQuat(const glm::quat& q);
+	glm::quat unpackQuat(uint64_t packed);
+
+	//Angle wrapped to [0, 2pi) in 16 bits, off by at most pi / 2^16
+	uint16_t packAngle(float radians);
+	float unpackAngle(uint16_t packed);
+
+	//Synced state of one player and one collectible, as sent in the previous frame
+	struct PlayerState
+	{
+		PlayerData mPlayerData;
+		PositionData mPositionData;
+		float mTurnSpeed;
+		uint32_t mMetadataVersion;
+	};
+
+	struct CollectibleState
+	{
+		CollectibleData mCollectData;
+		PositionData mPositionData;
+	};
+} // namespace SyncStream
+
+//Game flags and render time encode() in main.cpp sends ahead of every frame
+struct GameFrameHeader
+{
+	bool mIsGameEnded;
+	bool mAreStatsVisible;
+	bool mIsGameStarted;
+	float mRenderTime;
+
+	static constexpr size_t BYTES = 3 * sizeof(bool) + sizeof(float);
+
+	//Append to output, read returns false if input ends first
+	void write(std::vector<std::byte>& output) const;
+	bool read(ByteReader& input);
+};
+
+//Runs on master, turns the players and collectibles of a Simulation into frames
+class SyncEncoder
+{
+public:
+	SyncEncoder() = default;
+
+	//Send a keyframe every frames frames, 1 sends the full state every frame
+	void setKeyframeInterval(unsigned frames);
+
+	//Send player positions and turn speeds every frames frames, 1 sends every change
+	//Keyframes always carry them
+	void setPlayerSyncInterval(unsigned frames);
+
+	//Send collectible spawns and collects instead of collectibles in delta frames
+	//simulation has to log them, see Simulation::setCollectEventLogging, and the log
+	//has to be cleared after every encode. Nodes catch up with a keyframe
+	void setCollectibleEvents(bool enabled) { mCollectibleEvents = enabled, mForceKeyframe = true; }
+
+	//Make the next frame a keyframe
+	void requestKeyframe() { mForceKeyframe = true; }
+
+	//Append a frame with the rendered state of simulation to output
+	//The frame is serialized in place, so an output reused between frames only
+	//allocates when a frame is larger than any before it
+	void encode(const Simulation& simulation, std::vector<std::byte>& output);
+
+	//Largest possible frame with numPlayers players, numCollectibles collectibles
+	//and numCollectEvents logged collectible events
+	static size_t maxFrameBytes(size_t numPlayers, size_t numCollectibles, size_t numCollectEvents = 0);
+
+	//Bytes encode() reserves after the end of output for the next frame of simulation,
+	//at least the largest frame of the counts simulation was set up for. An output
+	//reserved for this much more is not grown by encode()
+	size_t getReserveBytes(const Simulation& simulation) const;
+
+	//Accessors
+	unsigned getKeyframeInterval() const { return mKeyframeInterval; }
+	bool wasKeyframe() const { return mLastWasKeyframe; }
+	const SyncFrameStats& getFrameStats() const { return mFrameStats; }
+
+private:
+	void encodeFrame(const Simulation& simulation, ByteWriter& output);
+	void encodeMetadata(const Simulation& simulation, bool isKeyframe, ByteWriter& output);
+	void encodePlayers(const Simulation& simulation, bool isKeyframe, bool syncMotion, ByteWriter& output);
+	void encodeCollectibles(const Simulation& simulation, bool isKeyframe, ByteWriter& output);
+	void encodeCollectEvents(const Simulation& simulation, ByteWriter& output);
+
+	//State sent in the previous frame, indexed by slot
+	std::vector<SyncStream::PlayerState> mPlayers;
+	std::vector<SyncStream::CollectibleState> mCollectibles;
+
+	//Sizes and encode time of the last frame
+	SyncFrameStats mFrameStats;
+
+	unsigned mKeyframeInterval = 60;
+	unsigned mPlayerSyncInterval = 1;
+	bool mCollectibleEvents = false;
+	uint32_t mSequence = 0;
+	bool mForceKeyframe = true;
+	bool mLastWasKeyframe = false;
+};
+
+//Runs on render nodes, writes frames straight into the players and collectibles
+//of a Simulation that is only changed by frames
+class SyncDecoder
+{
+public:
+	SyncDecoder() = default;
+
+	//Read the frame starting at data[pos] into simulation and move pos past it
+	//Returns true if the frame was applied. Delta frames that do not follow the last
+	//applied frame are skipped until the next keyframe arrives
+	//Parses data in place and only allocates when players join or the collectible pool grows
+	bool decode(ByteSpan data, size_t& pos, Simulation& simulation);
+
+	//Same as above with the position type sgct decode callbacks use
+	bool decode(const std::vector<std::byte>& data, unsigned int& pos, Simulation& simulation);
+
+	//Accessors
+	bool hasKeyframe() const { return mHasKeyframe; }
+	unsigned getNumSkippedFrames() const { return mNumSkippedFrames; }
+	const SyncFrameStats& getFrameStats() const { return mFrameStats; }
+
+private:
+	bool decodeFrame(ByteReader& input, Simulation& simulation);
+
+	//Apply one section, false if the data is malformed
+	bool decodeMetadata(ByteReader& input, Simulation& simulation);
+	bool decodePlayers(ByteReader& input, Simulation& simulation, bool isKeyframe);
+	bool decodeCollectibles(ByteReader& input, Simulation& simulation, bool isKeyframe);
+	bool decodeCollectEvents(ByteReader& input, Simulation& simulation);
+
+	//Newest metadata received, indexed by player id, version 0 if none yet
+	//Players joining in a frame are created from it
+	std::vector<PlayerMetadata> mMetadata;
+
+	uint32_t mLastSequence = 0;
+	bool mHasKeyframe = false;
+
+	//Frames dropped while waiting for a keyframe
+	unsigned mNumSkippedFrames = 0;
+
+	//Sizes and decode times of the last frame
+	SyncFrameStats mFrameStats;
+};
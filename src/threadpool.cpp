@@ -0,0 +1,100 @@
+#include "threadpool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned numWorkers)
+{
+	mWorkers.reserve(numWorkers);
+	for (unsigned i = 0; i < numWorkers; ++i)
+	{
+		//Range 0 belongs to the calling thread
+		mWorkers.emplace_back(&ThreadPool::workerLoop, this, i + 1);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mWorkReady.notify_all();
+
+	for (std::thread& worker : mWorkers)
+		worker.join();
+}
+
+void ThreadPool::parallelFor(size_t count, size_t minRange, const RangeFunc& func)
+{
+	parallelFor(count, minRange, IndexedRangeFunc{ [&func](unsigned, size_t begin, size_t end)
+	{
+		func(begin, end);
+	} });
+}
+
+void ThreadPool::parallelFor(size_t count, size_t minRange, const IndexedRangeFunc& func)
+{
+	if (count == 0)
+		return;
+
+	//Enough work for every worker or as many ranges of minRange as fit
+	const size_t maxRanges = std::max<size_t>(1, count / std::max<size_t>(1, minRange));
+	const unsigned numRanges = static_cast<unsigned>(std::min<size_t>(mWorkers.size() + 1, maxRanges));
+
+	if (numRanges == 1)
+	{
+		func(0, 0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFunc = &func;
+		mCount = count;
+		mNumRanges = numRanges;
+		mPending = numRanges - 1;
+		++mGeneration;
+	}
+	mWorkReady.notify_all();
+
+	func(0, rangeBegin(0), rangeBegin(1));
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mWorkDone.wait(lock, [this]() { return mPending == 0; });
+	mFunc = nullptr;
+}
+
+unsigned ThreadPool::hardwareWorkers()
+{
+	const unsigned hardwareThreads = std::thread::hardware_concurrency();
+	return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+void ThreadPool::workerLoop(unsigned rangeIndex)
+{
+	unsigned lastGeneration = 0;
+	while (true)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mWorkReady.wait(lock, [&]() { return mStopping || mGeneration != lastGeneration; });
+		if (mStopping)
+			return;
+
+		lastGeneration = mGeneration;
+
+		//Small jobs do not use every worker
+		if (rangeIndex >= mNumRanges)
+			continue;
+
+		const IndexedRangeFunc& func = *mFunc;
+		const size_t begin = rangeBegin(rangeIndex);
+		const size_t end = rangeBegin(rangeIndex + 1);
+		lock.unlock();
+
+		func(rangeIndex, begin, end);
+
+		lock.lock();
+		if (--mPending == 0)
+			mWorkDone.notify_one();
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+
+//Fixed set of worker threads used to split simulation loops across cores
+//parallelFor cuts [0, count) into contiguous ranges that only depend on count,
+//minRange and the number of workers, so as long as func treats every element
+//independently the result is the same for any number of workers
+class ThreadPool
+{
+public:
+	using RangeFunc = std::function<void(size_t begin, size_t end)>;
+	using IndexedRangeFunc = std::function<void(unsigned rangeIndex, size_t begin, size_t end)>;
+
+	//Starts numWorkers threads, with 0 workers everything runs on the calling thread
+	explicit ThreadPool(unsigned numWorkers);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	//Calls func on ranges covering [0, count) and returns when all have finished
+	//Ranges are at least minRange long, the calling thread takes the first range
+	void parallelFor(size_t count, size_t minRange, const RangeFunc& func);
+
+	//Same as above but func also gets the index of its range, always less than getMaxRanges()
+	//Ranges are in order, so per range output concatenated by index is in element order
+	void parallelFor(size_t count, size_t minRange, const IndexedRangeFunc& func);
+
+	//Accessors
+	unsigned getNumWorkers() const { return static_cast<unsigned>(mWorkers.size()); }
+	unsigned getMaxRanges() const { return getNumWorkers() + 1; }
+
+	//Number of workers that, with the calling thread, occupy every hardware thread
+	static unsigned hardwareWorkers();
+
+private:
+	void workerLoop(unsigned rangeIndex);
+
+	//[begin, end) of range rangeIndex out of mNumRanges
+	size_t rangeBegin(unsigned rangeIndex) const { return mCount * rangeIndex / mNumRanges; }
+
+	std::vector<std::thread> mWorkers;
+
+	std::mutex mMutex;
+	std::condition_variable mWorkReady;
+	std::condition_variable mWorkDone;
+
+	//Job shared by all workers, only valid during parallelFor
+	const IndexedRangeFunc* mFunc = nullptr;
+	size_t mCount = 0;
+	unsigned mNumRanges = 0;
+
+	//Bumped for every job so workers can tell a new job from a spurious wakeup
+	unsigned mGeneration = 0;
+
+	//Worker ranges of the current job that are not yet done
+	unsigned mPending = 0;
+
+	bool mStopping = false;
+};
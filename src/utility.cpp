@@ -17,28 +17,6 @@ std::string Utility::findRootDir()
 	return "";
 }
 
-std::tuple<unsigned, std::string> Utility::getNewPlayerData(std::istringstream& input)
-{
-	unsigned int id;
-	std::string name;
-
-	input >> id;
-	input >> name;
-
-	return std::make_tuple(id, name);
-}
-
-std::tuple<unsigned int, float> Utility::getTurnSpeed(std::istringstream& input)
-{
-	unsigned int id;
-	float rotAngle;
-
-	input >> id;
-	input >> rotAngle;
-
-	return std::make_tuple(id, rotAngle);
-}
-
 unsigned int Utility::textureFromFile(const char* path, const std::string& directory/* bool gamma*/)
 {
 	std::filesystem::path filename{ directory + '/' + std::string(path) };
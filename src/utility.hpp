@@ -25,10 +25,6 @@ class Utility
 public:
 	static std::string findRootDir();
 
-	static std::tuple<unsigned, std::string> getNewPlayerData(std::istringstream& input);
-
-	static std::tuple<unsigned int, float> getTurnSpeed(std::istringstream& input);
-
 	static unsigned int textureFromFile(const char* path, const std::string& directory/*bool gamma = false*/);
 
 private:
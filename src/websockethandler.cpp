@@ -32,13 +32,28 @@
 
 #include <sgct/profiling.h>
 #include "libwebsockets.h"
+#include "messagering.hpp"
 #include <algorithm>
+#include <atomic>
 #include <assert.h>
 #include <exception>
-#include <mutex>
 #include <string_view>
+#include <thread>
 #include <vector>
 
+namespace {
+    /// Messages that can wait to be sent before new ones are dropped
+    constexpr size_t MessageSlots = 4096;
+    /// Every slot is allocated with room for this many bytes, the messages the game
+    /// sends are all much smaller
+    constexpr size_t MessageSlotBytes = 64;
+    /// Largest payload of a frame with batched messages
+    constexpr size_t MaxBatchBytes = 4096;
+    /// Longest the service thread waits in lws_service before it checks whether it should
+    /// stop.  It is woken up earlier whenever there is something to do
+    constexpr int ServiceTimeoutMs = 100;
+} // namespace
+
 /// Private implementation (=pimpl) of the WebSocketHandler to hide all details in here
 struct WebSocketHandlerImpl {
     /// Address that we want to connect to
@@ -46,11 +61,30 @@ struct WebSocketHandlerImpl {
     /// Port at which to connect
     int port = 0;
 
-    /// Mutex that protects simulteanoues access to the messageQueue
-    std::mutex messageMutex;
-    /// The queued list of messages that will be sent one-by-one, whenever the sockets
-    /// reports that it is ready to be written to
-    std::vector<std::vector<std::byte>> messageQueue;
+    /// The queued messages that will be sent whenever the sockets reports that it is
+    /// ready to be written to.  Any thread can queue messages without locking and only
+    /// the thread that services the socket takes them out, which is the service thread
+    /// if there is one and the thread calling tick() otherwise
+    MessageRing messageQueue{ MessageSlots, MessageSlotBytes, LWS_PRE };
+    /// Frame of batched messages that is being written, kept around so that sending does
+    /// not allocate
+    std::vector<std::byte> sendBuffer;
+    /// Whether small messages are sent together in one binary frame, see writeFrame
+    bool batchMessages = false;
+    /// Whether messages are sent as binary frames instead of text frames
+    bool isBinary = false;
+
+    /// Names of the protocols offered to the server, in order of preference.  The
+    /// protocol list has to point at them as long as the context exists
+    std::vector<std::string> protocolNames;
+    std::vector<lws_protocols> protocols;
+    /// protocolNames separated by commas, as they are sent to the server
+    std::string offeredProtocols;
+    /// The protocol the server picked from protocolNames.  Written by the callbacks
+    /// without a lock, so it is only read on the thread that services the socket
+    std::string protocol;
+    /// Messages that were dropped because the queue was full
+    std::atomic<unsigned> numDroppedMessages{ 0 };
 
     /// The user's function pointer that is called when a connection is established
     std::function<void()> connectionEstablished;
@@ -60,13 +94,22 @@ struct WebSocketHandlerImpl {
     /// includes the data of the message
     std::function<void(const void*, size_t)> messageReceived;
 
-    bool isConnected = false;
+    /// Written by the callbacks, which run on the service thread if there is one
+    std::atomic<bool> isConnected{ false };
 
     /// The disconnect method sets this to \c true.  We can't disconnect the socket
     /// directly, but have to wait for a round-trip through the callback method, which
     /// needs to return -1 in order to signal to libwebsocket that it should close it.
     /// ¯\_(ツ)_/¯
-    bool wantsToDisconnect = false;
+    std::atomic<bool> wantsToDisconnect{ false };
+
+    /// Thread that runs lws_service, if startServiceThread was called.  All libwebsocket
+    /// calls are made on this thread then, except lws_cancel_service which wakes it up
+    std::thread serviceThread;
+    std::atomic<bool> stopServiceThread{ false };
+    /// The context the service thread runs, the callbacks reset context when the
+    /// connection closes
+    lws_context* serviceContext = nullptr;
 
     /// A pointer to the context that contains our protocol and connection
     lws_context* context = nullptr;
@@ -75,6 +118,48 @@ struct WebSocketHandlerImpl {
     lws* connection = nullptr;
 };
 
+/// Sends the first queued message in a frame of its own or, if batching is enabled and
+/// more messages are waiting, as many of them as fit into MaxBatchBytes in one binary
+/// frame.  Each message in a batch is prefixed with its length as a 16-bit little-endian
+/// number.  Returns the result of lws_write
+int writeFrame(WebSocketHandlerImpl& impl, lws* wsi) {
+    MessageBuffer* first = impl.messageQueue.front();
+    const MessageBuffer* second = impl.messageQueue.peek(1);
+    const bool isBatch = impl.batchMessages && second &&
+        1 + 2 + first->getSize() + 2 + second->getSize() <= MaxBatchBytes;
+
+    // A message on its own is sent straight from its slot.  Every slot keeps LWS_PRE
+    // bytes in front of the message, which libwebsocket needs for the frame header
+    if (!isBatch) {
+        unsigned char* p = reinterpret_cast<unsigned char*>(first->getData());
+        const lws_write_protocol type = impl.isBinary ? LWS_WRITE_BINARY : LWS_WRITE_TEXT;
+        const int result = lws_write(wsi, p, first->getSize(), type);
+        impl.messageQueue.pop();
+        return result;
+    }
+
+    // A batch has to be put together in a buffer of its own, with the same padding.  If
+    // every message is a binary frame, a batch is marked by starting with a 0 byte
+    std::vector<std::byte>& buffer = impl.sendBuffer;
+    buffer.resize(LWS_PRE);
+    if (impl.isBinary) {
+        buffer.push_back(std::byte(0));
+    }
+    const MessageBuffer* msg;
+    while ((msg = impl.messageQueue.front()) &&
+           buffer.size() + 2 + msg->getSize() <= LWS_PRE + MaxBatchBytes)
+    {
+        const size_t size = msg->getSize();
+        buffer.push_back(std::byte(size & 0xFF));
+        buffer.push_back(std::byte(size >> 8));
+        buffer.insert(buffer.end(), msg->getData(), msg->getData() + size);
+        impl.messageQueue.pop();
+    }
+
+    unsigned char* p = reinterpret_cast<unsigned char*>(buffer.data() + LWS_PRE);
+    return lws_write(wsi, p, buffer.size() - LWS_PRE, LWS_WRITE_BINARY);
+}
+
 int callback(lws* wsi, lws_callback_reasons reason, void* u, void* in, size_t len) {
     ZoneScoped
 
@@ -88,8 +173,19 @@ int callback(lws* wsi, lws_callback_reasons reason, void* u, void* in, size_t le
     void* usr = lws_get_protocol(wsi) ? lws_get_protocol(wsi)->user : nullptr;
     WebSocketHandlerImpl* pImpl = reinterpret_cast<WebSocketHandlerImpl*>(usr);
 
-    if (pImpl && pImpl->wantsToDisconnect) {
-        pImpl->wantsToDisconnect = false;
+    // Another thread woke up the service thread through lws_cancel_service, because it
+    // queued messages or wants to disconnect.  This is not a callback for our connection,
+    // so we ask for one to happen
+    if (reason == LWS_CALLBACK_EVENT_WAIT_CANCELLED) {
+        if (pImpl && pImpl->connection &&
+            (pImpl->wantsToDisconnect || !pImpl->messageQueue.empty()))
+        {
+            lws_callback_on_writable(pImpl->connection);
+        }
+        return 0;
+    }
+
+    if (pImpl && pImpl->wantsToDisconnect.exchange(false)) {
         return -1;
     }
 
@@ -97,6 +193,7 @@ int callback(lws* wsi, lws_callback_reasons reason, void* u, void* in, size_t le
         case LWS_CALLBACK_CLIENT_ESTABLISHED:
             assert(pImpl);
             pImpl->isConnected = true;
+            pImpl->protocol = lws_get_protocol(wsi)->name;
             pImpl->connectionEstablished();
             lws_callback_on_writable(wsi);
             break;
@@ -109,30 +206,17 @@ int callback(lws* wsi, lws_callback_reasons reason, void* u, void* in, size_t le
             ZoneScopedN("Write to WebSocket")
 
             assert(pImpl);
-            std::lock_guard lock(pImpl->messageMutex);
-            if (pImpl->messageQueue.empty()) {
-                break;
+            // Keep writing frames for as long as the socket takes them, instead of one
+            // message per tick().  If the socket fills up first, we ask to be called
+            // again as soon as it has room
+            while (!pImpl->messageQueue.empty() && !lws_send_pipe_choked(wsi)) {
+                if (writeFrame(*pImpl, wsi) < 0) {
+                    return -1;
+                }
+            }
+            if (!pImpl->messageQueue.empty()) {
+                lws_callback_on_writable(wsi);
             }
-
-            // Get a copy of first message from the queue.  Don't change this into a
-            // reference or we will have a dangling reference after the following erase
-            std::vector<std::byte> msg = pImpl->messageQueue.front();
-            pImpl->messageQueue.erase(pImpl->messageQueue.begin());
-
-            // Libwebsocket requires a padding in the beginning to include
-            // websocket-related information.  This is seems quite a dirty way of handling
-            // this, but what do I know ¯\_(ツ)_/¯
-            std::vector<std::byte> buffer(LWS_PRE + msg.size());
-            // Null out the entire block, just to be sure we don't send any garbage
-            std::fill(buffer.begin(), buffer.end(), std::byte(0));
-            // Insert the message in the middle block
-            std::copy(msg.begin(), msg.end(), buffer.begin() + LWS_PRE);
-
-            // Send the message.
-            // Yes, we have to pass the pointer past the padding and send the size of the
-            // message, not the buffer...  that is not an error -.-
-            unsigned char* p = reinterpret_cast<unsigned char*>(buffer.data() + LWS_PRE);
-            lws_write(wsi, p, msg.size(), LWS_WRITE_TEXT);
             break;
         }
         case LWS_CALLBACK_CLIENT_CLOSED:
@@ -183,20 +267,34 @@ WebSocketHandler::WebSocketHandler(std::string address, int port,
     _pImpl->connectionEstablished = std::move(connectionEstablished);
     _pImpl->connectionClosed = std::move(connectionClosed);
     _pImpl->messageReceived = std::move(msgReceived);
+    _pImpl->sendBuffer.reserve(LWS_PRE + MaxBatchBytes);
 }
 
 WebSocketHandler::~WebSocketHandler() {
     disconnect();
-    tick();
+    if (_pImpl->serviceThread.joinable()) {
+        // Whatever the thread did not get to is closed with the context
+        _pImpl->stopServiceThread = true;
+        lws_cancel_service(_pImpl->serviceContext);
+        _pImpl->serviceThread.join();
+    }
+    else {
+        tick();
+    }
 
     lws_context_destroy(_pImpl->context);
     _pImpl = nullptr;
 }
 
 bool WebSocketHandler::connect(std::string protocolName, int bufferSize) {
+    return connect(std::vector<std::string>{ std::move(protocolName) }, bufferSize);
+}
+
+bool WebSocketHandler::connect(std::vector<std::string> protocolNames, int bufferSize) {
     ZoneScoped
 
     assert(bufferSize >= 0);
+    assert(!protocolNames.empty());
 
     lws_context_creation_info info;
     std::memset(&info, 0, sizeof(info));
@@ -205,14 +303,21 @@ bool WebSocketHandler::connect(std::string protocolName, int bufferSize) {
 
     // This is a bit ugly;  we pass in the address to the callbacks structure so that we
     // can access it as the user pointer of the protocol inside the callback function
-    // whenever something interesting happens in the websocket connection
+    // whenever something interesting happens in the websocket connection.  Every
+    // protocol we offer uses the same callback, the server picks one of them
     const size_t bufSize = static_cast<size_t>(bufferSize);
-    const lws_protocols protocols[] = {
-        { protocolName.c_str(), callback, 0, bufSize, 0, _pImpl.get() },
-        { nullptr, nullptr, 0, 0, 0, nullptr } // terminal value
-    };
+    _pImpl->protocolNames = std::move(protocolNames);
+    _pImpl->protocols.clear();
+    std::string& offeredProtocols = _pImpl->offeredProtocols;
+    offeredProtocols.clear();
+    for (const std::string& name : _pImpl->protocolNames) {
+        _pImpl->protocols.push_back({ name.c_str(), callback, 0, bufSize, 0, _pImpl.get() });
+        offeredProtocols += offeredProtocols.empty() ? name : "," + name;
+    }
+    _pImpl->protocols.push_back({ nullptr, nullptr, 0, 0, 0, nullptr }); // terminal value
+    _pImpl->protocol.clear();
 
-    info.protocols = protocols;
+    info.protocols = _pImpl->protocols.data();
     info.gid = -1;
     info.uid = -1;
 
@@ -225,13 +330,19 @@ bool WebSocketHandler::connect(std::string protocolName, int bufferSize) {
     ccinfo.path = "/";
     ccinfo.host = lws_canonical_hostname(_pImpl->context);
     ccinfo.origin = "origin";
-    ccinfo.protocol = protocols[0].name;
+    ccinfo.protocol = offeredProtocols.c_str();
 
     _pImpl->connection = lws_client_connect_via_info(&ccinfo);
     return _pImpl->connection != nullptr;
 }
 
 void WebSocketHandler::disconnect() {
+    if (_pImpl->serviceThread.joinable()) {
+        _pImpl->wantsToDisconnect = true;
+        lws_cancel_service(_pImpl->serviceContext);
+        return;
+    }
+
     if (_pImpl->context && _pImpl->connection) {
         _pImpl->wantsToDisconnect = true;
         lws_callback_on_writable(_pImpl->connection);
@@ -245,28 +356,77 @@ bool WebSocketHandler::isConnected() const {
 void WebSocketHandler::tick() {
     ZoneScoped
 
+    // The service thread receives by itself, it only has to be told that there are new
+    // messages to send
+    if (_pImpl->serviceThread.joinable()) {
+        lws_cancel_service(_pImpl->serviceContext);
+        return;
+    }
+
     if (_pImpl->context && _pImpl->connection) {
         lws_callback_on_writable(_pImpl->connection);
         lws_service(_pImpl->context, 0);
     }
 }
 
-void WebSocketHandler::queueMessage(std::string message) {
-    std::vector<std::byte> msg(message.size());
-    std::transform(
-        message.begin(), message.end(),
-        msg.begin(),
-        [](char c) { return static_cast<std::byte>(c); }
-    );
-    queueMessage(std::move(msg));
+MessageBuffer* WebSocketHandler::newMessage() {
+    MessageBuffer* message = _pImpl->messageQueue.claim();
+    if (!message) {
+        ++_pImpl->numDroppedMessages;
+    }
+    return message;
+}
+
+void WebSocketHandler::queueMessage(MessageBuffer* message) {
+    assert(message);
+    _pImpl->messageQueue.commit(message);
+}
+
+void WebSocketHandler::queueMessage(std::string_view message) {
+    if (!_pImpl->messageQueue.push(message.data(), message.size())) {
+        ++_pImpl->numDroppedMessages;
+    }
+}
+
+void WebSocketHandler::queueMessage(const std::vector<std::byte>& message) {
+    if (!_pImpl->messageQueue.push(message.data(), message.size())) {
+        ++_pImpl->numDroppedMessages;
+    }
+}
+
+void WebSocketHandler::startServiceThread() {
+    assert(!_pImpl->serviceThread.joinable());
+    if (!_pImpl->context || !_pImpl->connection) {
+        return;
+    }
+
+    _pImpl->serviceContext = _pImpl->context;
+    _pImpl->stopServiceThread = false;
+    _pImpl->serviceThread = std::thread([pImpl = _pImpl.get()]() {
+        // The connection is reset by the callbacks when it is closed, which happens
+        // inside lws_service on this thread
+        while (!pImpl->stopServiceThread && pImpl->connection) {
+            lws_service(pImpl->serviceContext, ServiceTimeoutMs);
+        }
+    });
 }
 
-void WebSocketHandler::queueMessage(std::vector<std::byte> message) {
-    std::lock_guard lock(_pImpl->messageMutex);
-    _pImpl->messageQueue.push_back(std::move(message));
+void WebSocketHandler::setBatching(bool batchMessages) {
+    _pImpl->batchMessages = batchMessages;
+}
+
+void WebSocketHandler::setBinary(bool isBinary) {
+    _pImpl->isBinary = isBinary;
+}
+
+const std::string& WebSocketHandler::protocol() const {
+    return _pImpl->protocol;
 }
 
 int WebSocketHandler::queueSize() const {
-    std::lock_guard lock(_pImpl->messageMutex);
     return static_cast<int>(_pImpl->messageQueue.size());
 }
+
+unsigned WebSocketHandler::droppedMessages() const {
+    return _pImpl->numDroppedMessages;
+}
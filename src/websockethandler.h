@@ -34,8 +34,11 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 struct WebSocketHandlerImpl;
+class MessageBuffer;
 
 /**
  * This class handles a websocket connection using the libwebsocket library.  To establish
@@ -44,14 +47,35 @@ struct WebSocketHandlerImpl;
  * callbacks for when messages are received through this socket connection (see below).
  * Then call the #connect method with a specific protocolName (which has to match the
  * clients parameter in the <code>new WebSocket(url, 'protocol')</code> call) and a buffer
- * size in which a received message has to fit.
+ * size in which a received message has to fit.  #connect also takes a list of protocol
+ * names in order of preference, of which the server picks one.  After the connection
+ * is established, #protocol returns the name of the protocol that was picked.  The name
+ * is set without a lock by the thread that services the socket, so only read it there,
+ * e.g. in the <code>connectionEstablished</code> callback.
  * 
  * After that, the #tick method has to be called regularly (preferrably every frame) by
- * your application to be able to receive messages.
+ * your application to be able to receive messages.  Alternatively, #startServiceThread
+ * starts a thread that receives and sends messages as soon as the socket is ready.  The
+ * callbacks are then called on that thread and #tick only wakes it up to send the
+ * messages that were queued since the last call.
  *
  * If you want send a message to the client, you can queue a message to be sent using the
- * #queueMessage method, which will add the message to the queue handled internally.  At
- * any point you can query the size of the queue through the #queueSize method.
+ * #queueMessage method, which will add the message to the queue handled internally.  To
+ * avoid copying the message, get a buffer with #newMessage, write the message into it
+ * and pass it to #queueMessage.  The buffers are reused and have room for the websocket
+ * frame header in front of the message, so the message is sent from where it was
+ * written.  Every buffer from #newMessage has to be queued, or no message behind it can
+ * be sent.  At
+ * any point you can query the size of the queue through the #queueSize method.  Messages
+ * can be queued from any thread without blocking.  The queue is bounded, if it is full
+ * the message is dropped and counted in #droppedMessages.
+ *
+ * Whenever the socket is writable, queued messages are sent until the queue is empty or
+ * the socket is full.  With #setBatching, messages that are waiting together are sent in
+ * one binary frame, in which every message is prefixed by its length as a 16-bit
+ * little-endian number.  A message that is sent on its own is a text frame, so the
+ * receiver can tell the two apart by the frame type.  After #setBinary, every message is
+ * sent as a binary frame and a batch is marked by a 0 byte in front of it instead.
  *
  * You can prematurely close the connection through the #disconnect message.
  *
@@ -75,13 +99,21 @@ public:
     ~WebSocketHandler();
 
     bool connect(std::string protocolName, int bufferSize);
+    bool connect(std::vector<std::string> protocolNames, int bufferSize);
     void disconnect();
     bool isConnected() const;
     void tick();
+    void startServiceThread();
 
-    void queueMessage(std::string message);
-    void queueMessage(std::vector<std::byte> message);
+    MessageBuffer* newMessage();
+    void queueMessage(MessageBuffer* message);
+    void queueMessage(std::string_view message);
+    void queueMessage(const std::vector<std::byte>& message);
+    void setBatching(bool batchMessages);
+    void setBinary(bool isBinary);
+    const std::string& protocol() const;
     int queueSize() const;
+    unsigned droppedMessages() const;
 
 private:
     std::unique_ptr<WebSocketHandlerImpl> _pImpl;
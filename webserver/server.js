@@ -18,6 +18,181 @@ global.uniqueId = 0;
 //Store all players and their id
 global.playerList = new Map(); // {"ip", id}
 
+//
+// Messages between the game and this server, see src/relayprotocol.hpp in the game
+// The game offers both protocols and the binary one is picked when it is offered:
+//   TEXT_PROTOCOL    The original text messages, e.g. "C 3 0.25"
+//   BINARY_PROTOCOL  Type byte, the letter of the text message, followed by base 128
+//                    varints. Signed values are zigzag encoded. Turn speed is in 1/1024,
+//                    passed time in 1/1000 of the round and colours are one byte per
+//                    component
+// The phones always get text messages
+//
+const TEXT_PROTOCOL = 'example-protocol';
+const BINARY_PROTOCOL = 'domedagen-binary-1';
+const TURN_SPEED_SCALE = 1024;
+
+//Reads a binary message from the game, throws if it ends too early
+class BinaryReader {
+  constructor(bytes) {
+    this.bytes = bytes;
+    this.cursor = 0;
+  }
+
+  byte() {
+    if (this.cursor >= this.bytes.length) {
+      throw new RangeError('Message from game ended too early');
+    }
+    return this.bytes[this.cursor++];
+  }
+
+  varint() {
+    let value = 0;
+    for (let shift = 0; shift < 35; shift += 7) {
+      const byte = this.byte();
+      value += (byte & 0x7f) * 2 ** shift;
+      if (!(byte & 0x80)) {
+        return value;
+      }
+    }
+    throw new RangeError('Varint from game is too long');
+  }
+
+  zigzag() {
+    const value = this.varint();
+    return value % 2 ? -(value + 1) / 2 : value / 2;
+  }
+}
+
+function writeVarint(bytes, value) {
+  do {
+    let byte = value % 128;
+    value = Math.floor(value / 128);
+    bytes.push(value ? byte | 0x80 : byte);
+  } while (value);
+}
+
+function writeZigzag(bytes, value) {
+  writeVarint(bytes, value < 0 ? -2 * value - 1 : 2 * value);
+}
+
+// Decode a message from the game into {type, id, colour, points, time, hasEnded},
+// null if it is not one the phones care about
+function decodeGameMessage(data, binary) {
+  if (binary) {
+    const input = new BinaryReader(data);
+    const type = String.fromCharCode(input.byte());
+    if (type === 'A' || type === 'B') {
+      return { type, id: input.varint(), colour: [input.byte(), input.byte(), input.byte()] };
+    } else if (type === 'P') {
+      return { type, id: input.varint(), points: input.zigzag() };
+    } else if (type === 'T') {
+      return { type, time: input.varint() / 1000 };
+    } else if (type === 'U') {
+      return { type, hasEnded: input.byte() === 1 };
+    }
+    return null;
+  }
+
+  const type = data[0];
+  if (type === 'A' || type === 'B') {
+    // The colour is written like glm::to_string, e.g. "A vec3(0.1, 0.2, 0.3) 4"
+    const match = /vec3\(([^,]+), ([^,]+), ([^)]+)\) (\d+)/.exec(data);
+    if (!match) {
+      return null;
+    }
+    return { type, id: Number(match[4]), colour: [match[1] * 255, match[2] * 255, match[3] * 255] };
+  } else if (type === 'P') {
+    const fields = data.split(/ +/);
+    return { type, id: Number(fields[1]), points: Number(fields[2]) };
+  } else if (type === 'T') {
+    return { type, time: Number(data.substring(2)) };
+  } else if (type === 'U') {
+    return { type, hasEnded: data.substring(2) === 'end' };
+  }
+  return null;
+}
+
+// Call handler with each message from the game in msg
+//
+// With batching turned on in the game (batchMessages in config.ini), messages that were
+// waiting together arrive in one binary frame:
+//   [0]             Only with BINARY_PROTOCOL, 0 is never a type byte so it marks a batch
+//   [len lo][len hi][message]  Repeated, the length of each message is a 16-bit
+//                              little-endian number
+// With TEXT_PROTOCOL the messages in a batch are text and every binary frame is a batch,
+// single messages are text frames
+function forEachGameMessage(msg, handler) {
+  try {
+    if (msg.type === 'utf8') {
+      const message = decodeGameMessage(msg.utf8Data, false);
+      if (message) {
+        handler(message);
+      }
+      return;
+    }
+
+    const data = msg.binaryData;
+    if (gameBinary && data.length > 0 && data[0] !== 0) {
+      const message = decodeGameMessage(data, true);
+      if (message) {
+        handler(message);
+      }
+      return;
+    }
+
+    let cursor = gameBinary ? 1 : 0;
+    while (cursor + 2 <= data.length) {
+      const size = data.readUInt16LE(cursor);
+      cursor += 2;
+      if (cursor + size > data.length) {
+        throw new RangeError('Batch from game ended too early');
+      }
+      const bytes = data.subarray(cursor, cursor + size);
+      cursor += size;
+      const message = decodeGameMessage(gameBinary ? bytes : bytes.toString('utf8'), gameBinary);
+      if (message) {
+        handler(message);
+      }
+    }
+  } catch (error) {
+    console.log(`Could not read message from game: ${error.message}`);
+  }
+}
+
+// Send a message to the game in the protocol it connected with
+// text is the text message, bytes the same message in the binary format
+function sendToGame(text, bytes) {
+  if (gameBinary) {
+    gameSocket.sendBytes(Buffer.from(bytes));
+  } else {
+    gameSocket.send(text);
+  }
+}
+
+// type is N, D, E or I
+function sendId(type, id) {
+  const bytes = [type.charCodeAt(0)];
+  writeVarint(bytes, id);
+  sendToGame(`${type} ${id}`, bytes);
+}
+
+function sendJoin(id, name) {
+  const bytes = ['N'.charCodeAt(0)];
+  const text = Buffer.from(name, 'utf8');
+  writeVarint(bytes, id);
+  writeVarint(bytes, text.length);
+  bytes.push(...text);
+  sendToGame(`N ${id} ${name}`, bytes);
+}
+
+function sendTurn(id, turnSpeed) {
+  const bytes = ['C'.charCodeAt(0)];
+  writeVarint(bytes, id);
+  writeZigzag(bytes, Math.round(Number(turnSpeed) * TURN_SPEED_SCALE));
+  sendToGame(`C ${id} ${turnSpeed}`, bytes);
+}
+
 //
 //
 var config = JSON.parse(fs.readFileSync('config.json'));
@@ -41,6 +216,8 @@ server.listen(port, function () {
 })
 
 var gameSocket = null;
+// True if the game connected with BINARY_PROTOCOL
+var gameBinary = false;
 var connectionArray = [];
 
 var wsServer = new WebSocketServer({ httpServer: server });
@@ -48,7 +225,9 @@ wsServer.on('request', function (req) {
   if (req.remoteAddress === gameAddress) {
     console.log('Game connection established');
 
-    gameSocket = req.accept("example-protocol", req.origin);
+    gameBinary = req.requestedProtocols.indexOf(BINARY_PROTOCOL) !== -1;
+    gameSocket = req.accept(gameBinary ? BINARY_PROTOCOL : TEXT_PROTOCOL, req.origin);
+    console.log(`Talking to the game using ${gameSocket.protocol}`);
 
     gameSocket.on('message', function(msg) {
       if (msg.type === 'utf8') {
@@ -83,55 +262,29 @@ wsServer.on('request', function (req) {
       connection.send('Connected');
 
       gameSocket.on('message', function(msg) {
-        if (msg.type === 'utf8') {
-          var temp = msg.utf8Data;
+        forEachGameMessage(msg, function(message) {
           const remotePlayerAddress = connection.socket.remoteAddress;
           const idNumber = playerList.get(remotePlayerAddress);
 
           // Receive colour-data from game and send to client
-          if (temp[0] === 'A') {
-            var valOne = temp.substring(7, 14) * 255;
-            var valTwo = temp.substring(17, 24) * 255;
-            var valThree = temp.substring(27, 34) * 255;
-            var playerColourId1 = temp.substring(36);
-            console.log(`PLAYERID: ${playerColourId1}`);
-
-            var colourOne = [valOne, valTwo, valThree];
-            if (playerColourId1 == idNumber) {
-              connection.send(`A ${colourOne}`);
-            }
-
-          } else if (temp[0] === 'B') {
-            var valOne = temp.substring(7, 14) * 255;
-            var valTwo = temp.substring(17, 24) * 255;
-            var valThree = temp.substring(27, 34) * 255;
-            var playerColourId2 = temp.substring(36);
-
-            var colourTwo = [valOne, valTwo, valThree];
-
-            if (playerColourId2 == idNumber) {
-              connection.send(`B ${colourTwo}`);
+          if (message.type === 'A' || message.type === 'B') {
+            if (message.id === idNumber) {
+              connection.send(`${message.type} ${message.colour}`);
             }
 
             // Receive points from game and send to website
-          } else if (temp[0] === 'P') {
-            var pointsId = temp.substring(2, 4);
-            var points = temp.substring(5);
-
-            if (pointsId == idNumber) {
-              //console.log(`POINTS for player ${pointsId}: ${points}`);
-              connection.send(`P ${points}`);
+          } else if (message.type === 'P') {
+            if (message.id === idNumber) {
+              //console.log(`POINTS for player ${message.id}: ${message.points}`);
+              connection.send(`P ${message.points}`);
             }
 
-          } else if (temp[0] === 'T') {
-            var time = temp.substring(2, 6);
-
-            //console.log(`Colour 2: ${colourTwo}`);
-            connection.send(`T ${time}`);
-          } else if (temp[0] === 'U') {
-            connection.send(temp);
+          } else if (message.type === 'T') {
+            connection.send(`T ${message.time}`);
+          } else if (message.type === 'U') {
+            connection.send(message.hasEnded ? 'U end' : 'U start');
           }
-        }
+        });
       });
 
       // Do something with the connection
@@ -147,9 +300,9 @@ wsServer.on('request', function (req) {
 
             playerList.set(connection.socket.remoteAddress, uniqueId);
             console.log(playerList);
-            gameSocket.send(`N ${uniqueId} ${temp[1]}`);
+            sendJoin(uniqueId, temp[1] || '');
             // Send only ID to receive colors
-            gameSocket.send(`I ${uniqueId}`);
+            sendId('I', uniqueId);
             uniqueId++;
           }
 
@@ -157,7 +310,9 @@ wsServer.on('request', function (req) {
           else if (temp[0] === "C") {
             // Test sending some rotation data from the user's mobile device
             const playerId = playerList.get(req.remoteAddress);
-            gameSocket.send(`C ${playerId} ${temp[1]}`);
+            if (playerId !== undefined) {
+              sendTurn(playerId, temp[1]);
+            }
           }
         }
       });
@@ -170,7 +325,9 @@ wsServer.on('request', function (req) {
         const id = playerList.get(remoteAddress);
 
         //if (playerList.delete(remoteAddress)) {
-        gameSocket.send(`D ${id}`);
+        if (id !== undefined) {
+          sendId('D', id);
+        }
         console.log(`Removed player ${id} with ip ${remoteAddress}`);
         //}
       });
@@ -179,8 +336,8 @@ wsServer.on('request', function (req) {
     else {
       console.log('Same IP address connected twice');
     }
-    // First connection message with game online
-    if (gameSocket) {
+    // First connection message with game online, only the text protocol has room for it
+    if (gameSocket && !gameBinary) {
       gameSocket.send("Remote connection from: " + req.remoteAddress);
     }
   }